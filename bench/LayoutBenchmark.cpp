@@ -0,0 +1,120 @@
+// Micro-benchmark for the force-layout repulsion pass.
+// Compares the original array-of-structs loop with the packed structure-of-arrays
+// kernels (scalar and vector). Build with -DE4MAPS_BUILD_BENCHMARKS=ON.
+//
+// Usage: layout_benchmark [nodeCount ...]
+
+#include "LayoutKernels.hpp"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace {
+
+    const double REPULSION = 5000000.0;
+    const double CUTOFF_SQ = 800.0 * 800.0;
+
+    // Mirrors the original LayoutNode: an owning pointer next to the coordinates
+    struct AosNode {
+        std::shared_ptr<int> node;
+        double x, y;
+        double fx, fy;
+        bool fixed;
+    };
+
+    void repulsionAos(std::vector<AosNode>& nodes) {
+        for (size_t i = 0; i < nodes.size(); i++) {
+            if (nodes[i].fixed) continue;
+
+            for (size_t j = 0; j < nodes.size(); j++) {
+                if (i == j) continue;
+
+                double dx = nodes[i].x - nodes[j].x;
+                double dy = nodes[i].y - nodes[j].y;
+                double distSq = dx * dx + dy * dy;
+                if (distSq > CUTOFF_SQ) continue;
+
+                double distance = std::sqrt(distSq) + 0.1;
+                double factor = REPULSION / (distance * distance * distance);
+                nodes[i].fx += factor * dx;
+                nodes[i].fy += factor * dy;
+            }
+        }
+    }
+
+    template <typename Fn>
+    double bestOfMs(int runs, Fn fn) {
+        double best = 1e300;
+        for (int r = 0; r < runs; r++) {
+            auto start = std::chrono::steady_clock::now();
+            fn();
+            auto stop = std::chrono::steady_clock::now();
+            best = std::min(best, std::chrono::duration<double, std::milli>(stop - start).count());
+        }
+        return best;
+    }
+
+    void runCase(size_t count) {
+        std::mt19937 gen(1234);
+        // Roughly the density of a force-laid-out map: ~150px between neighbours
+        double extent = 150.0 * std::sqrt(static_cast<double>(count));
+        std::uniform_real_distribution<double> pos(-extent / 2.0, extent / 2.0);
+
+        std::vector<AosNode> aos(count);
+        LayoutKernels::LayoutArrays soa;
+        soa.resize(count);
+        for (size_t i = 0; i < count; i++) {
+            double x = pos(gen), y = pos(gen);
+            aos[i] = {std::make_shared<int>(static_cast<int>(i)), x, y, 0.0, 0.0, i == 0};
+            soa.x[i] = x;
+            soa.y[i] = y;
+            soa.setFixed(i, i == 0);
+        }
+
+        const int runs = 5;
+        double aosMs = bestOfMs(runs, [&]() {
+            for (auto& n : aos) { n.fx = 0.0; n.fy = 0.0; }
+            repulsionAos(aos);
+        });
+        std::printf("%8zu nodes  aos-loop  %9.3f ms\n", count, aosMs);
+
+        const LayoutKernels::Isa isas[] = {
+            LayoutKernels::Isa::Scalar, LayoutKernels::Isa::SSE2, LayoutKernels::Isa::AVX2
+        };
+        for (auto isa : isas) {
+            if (isa > LayoutKernels::detectIsa()) continue;
+
+            double ms = bestOfMs(runs, [&]() {
+                std::fill(soa.fx.begin(), soa.fx.end(), 0.0);
+                std::fill(soa.fy.begin(), soa.fy.end(), 0.0);
+                LayoutKernels::accumulateRepulsion(isa, soa, 0, count, REPULSION, CUTOFF_SQ);
+            });
+
+            double maxRelError = 0.0;
+            for (size_t i = 0; i < count; i++) {
+                double ref = std::hypot(aos[i].fx, aos[i].fy);
+                double diff = std::hypot(aos[i].fx - soa.fx[i], aos[i].fy - soa.fy[i]);
+                if (ref > 0.0) maxRelError = std::max(maxRelError, diff / ref);
+            }
+
+            std::printf("%8zu nodes  soa-%-6s %9.3f ms  x%5.2f  max rel. error %.2e\n",
+                        count, LayoutKernels::isaName(isa), ms, aosMs / ms, maxRelError);
+        }
+    }
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::vector<size_t> counts;
+    for (int i = 1; i < argc; i++) counts.push_back(std::strtoul(argv[i], nullptr, 10));
+    if (counts.empty()) counts = {1000, 5000, 20000};
+
+    std::printf("Repulsion pass, best of 5 (active kernel: %s)\n",
+                LayoutKernels::isaName(LayoutKernels::detectIsa()));
+    for (size_t count : counts) runCase(count);
+    return 0;
+}
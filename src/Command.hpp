@@ -77,11 +77,7 @@ public:
     void undo() override {
         if (!executed && parent && !nodeRef.expired()) {
             // Reinsert the node at its original position
-            if (position < parent->children.size()) {
-                parent->children.insert(parent->children.begin() + position, nodeRef.lock());
-            } else {
-                parent->addChild(nodeRef.lock());
-            }
+            parent->insertChild(position, nodeRef.lock());
             executed = true;
         }
     }
@@ -163,6 +159,7 @@ public:
             node->overrideTextColor = newOvrT;
             node->overrideFont = newOvrF;
             node->overrideConnFont = newOvrCF;
+            node->markSizeDirty();
             
             executed = true;
         }
@@ -186,6 +183,7 @@ public:
             node->overrideTextColor = oldOvrT;
             node->overrideFont = oldOvrF;
             node->overrideConnFont = oldOvrCF;
+            node->markSizeDirty();
             
             executed = false;
         }
@@ -329,11 +327,7 @@ public:
     void undo() override {
         if (executed && parent && nodeCopy) {
             // Reinsert the node copy at its original position
-            if (position < parent->children.size()) {
-                parent->children.insert(parent->children.begin() + position, copyNodeTree(nodeCopy));
-            } else {
-                parent->addChild(copyNodeTree(nodeCopy));
-            }
+            parent->insertChild(position, copyNodeTree(nodeCopy));
             executed = false;
         }
     }
@@ -561,11 +555,7 @@ public:
                     if (!nodeToRestore) continue;
 
                     // Reinsert at original position
-                    if (positions[i] < pair.first->children.size()) {
-                        pair.first->children.insert(pair.first->children.begin() + positions[i], nodeToRestore);
-                    } else {
-                        pair.first->addChild(nodeToRestore);
-                    }
+                    pair.first->insertChild(positions[i], nodeToRestore);
                 }
             }
             executed = false;
@@ -3,6 +3,9 @@
 
 #include <string>
 #include <deque>
+#include <map>
+#include <algorithm>
+#include <cstdlib>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
@@ -14,14 +17,18 @@ private:
     std::string m_lastDirFile;
     std::deque<std::string> m_recentFiles;
     std::string m_lastUsedDir;
+    std::string m_settingsFile;
+    std::map<std::string, std::string> m_settings;
 
 public:
     ConfigManager() {
         initializeConfigDir();
         m_recentFile = (std::filesystem::path(m_configDir) / "recent.txt").string();
         m_lastDirFile = (std::filesystem::path(m_configDir) / "lastdir.txt").string();
+        m_settingsFile = (std::filesystem::path(m_configDir) / "settings.conf").string();
         loadRecentFiles();
         loadLastUsedDirectory();
+        loadSettings();
     }
 
     void initializeConfigDir() {
@@ -96,6 +103,43 @@ public:
     const std::string& getLastUsedDirectory() const {
         return m_lastUsedDir;
     }
+
+    // Settings functionality: settings.conf holds one "key = value" per line, '#' starts
+    // a comment. The file is only read, it is there for tuning a deployment.
+    void loadSettings() {
+        m_settings.clear();
+        std::ifstream in(m_settingsFile);
+        std::string line;
+        while (std::getline(in, line)) {
+            line = line.substr(0, line.find('#'));
+            size_t equals = line.find('=');
+            if (equals == std::string::npos) continue;
+            std::string key = trim(line.substr(0, equals));
+            if (!key.empty()) m_settings[key] = trim(line.substr(equals + 1));
+        }
+    }
+
+    std::string getSetting(const std::string& key, const std::string& fallback) const {
+        auto it = m_settings.find(key);
+        return it != m_settings.end() ? it->second : fallback;
+    }
+
+    // Missing or malformed values give the fallback
+    double getNumberSetting(const std::string& key, double fallback) const {
+        auto it = m_settings.find(key);
+        if (it == m_settings.end() || it->second.empty()) return fallback;
+        char* end = nullptr;
+        double value = std::strtod(it->second.c_str(), &end);
+        return *end == '\0' ? value : fallback;
+    }
+
+private:
+    static std::string trim(const std::string& s) {
+        size_t begin = s.find_first_not_of(" \t\r");
+        if (begin == std::string::npos) return "";
+        size_t end = s.find_last_not_of(" \t\r");
+        return s.substr(begin, end - begin + 1);
+    }
 };
 
 #endif // CONFIG_MANAGER_HPP
\ No newline at end of file
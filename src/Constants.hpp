@@ -31,6 +31,30 @@ constexpr double MAX_DPI = 600.0;
 // Layout constants
 constexpr double INITIAL_RADIUS = 160.0;
 constexpr double ANGLE_OFFSET = 0.3;
+constexpr int BARNES_HUT_THRESHOLD = 500; // Node count above which repulsion switches to Barnes-Hut
+constexpr int PARALLEL_LAYOUT_MIN_NODES = 256; // Below this the force layout stays single-threaded
+constexpr double LAYOUT_TIME_BUDGET_MS = 1000.0; // Automatic engine choice: nicest layout expected to finish in this time
+constexpr int INCREMENTAL_LAYOUT_MAX_NODES = 500; // Moving + pinned nodes a local re-layout may touch
+constexpr double INCREMENTAL_LAYOUT_MARGIN = 300.0; // Pinned neighbourhood around the edited subtree
+constexpr int INCREMENTAL_LAYOUT_OVERLAP_BUDGET = 2; // Overlaps a local re-layout may leave before the global overlap removal runs
+constexpr double LAYOUT_SNAPSHOT_INTERVAL_MS = 50.0; // How often a running layout publishes positions
+constexpr double LAYOUT_ANIMATION_TIME_CONSTANT = 0.12; // Seconds for nodes to cover ~63% of the way to a snapshot
+constexpr double TIDY_TREE_SIBLING_GAP = 20.0; // Space between children of the same parent
+constexpr double TIDY_TREE_SUBTREE_GAP = 40.0; // Space between neighbouring subtrees
+constexpr double TIDY_TREE_LEVEL_GAP = 60.0; // Space between consecutive depths
+constexpr double OVERLAP_REMOVAL_GAP = 10.0; // Minimum space overlap removal leaves between node boxes
+
+// Rendering constants
+constexpr int TILE_SIZE = 256; // Edge of a cached map tile, in screen pixels
+constexpr size_t TILE_CACHE_MAX_BYTES = 64 * 1024 * 1024; // Rendered tiles kept across pans and zoom levels
+constexpr size_t TILE_SYNC_RENDER_LIMIT = 4; // Missing tiles a frame renders itself; more go to the render workers
+constexpr size_t MAX_DAMAGE_RECTS = 32; // Repaint areas queued per event before they are merged into one
+constexpr double LOD_SIMPLIFIED_NODE_PX = 20.0; // Node height on screen below which shadows, arrowheads and curves go
+constexpr double LOD_OVERVIEW_NODE_PX = 10.0; // Node height on screen below which nodes are bare boxes without text
+constexpr size_t TEXT_LAYOUT_CACHE_MAX_BYTES = 32 * 1024 * 1024; // Shaped text shared by all maps on the UI thread
+constexpr size_t WORKER_TEXT_LAYOUT_CACHE_MAX_BYTES = 4 * 1024 * 1024; // Shaped text kept by each render worker
+constexpr size_t ASYNC_MEASURE_MIN_NODES = 2000; // Maps this big have their text measured by the render workers
+constexpr size_t MEASURE_CHUNK_NODES = 512; // Nodes one worker task measures
 
 // Command history
 constexpr size_t MAX_COMMAND_HISTORY = 50;
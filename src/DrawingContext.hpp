@@ -6,14 +6,23 @@
 #include <thread>
 #include <atomic>
 #include <functional>
-#include <map>
+#include <mutex>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <unordered_set>
+#include <unordered_map>
+#include <algorithm>
+#include <cmath>
 #include <glibmm/dispatcher.h>
 #include "MindMap.hpp"
 #include "MindMapDrawer.hpp"
+#include "Selection.hpp"
+#include "TileCache.hpp"
+#include "ThreadPool.hpp"
 #include "Utils.hpp"
 #include "Constants.hpp"
 #include "LayoutAlgorithm.hpp"
-#include "MindMapUtils.hpp"
 
 struct Viewport {
     double offsetX = 0.0;
@@ -28,171 +37,531 @@ class DrawingContext : public sigc::trackable {
 private:
     Viewport viewport;
     std::shared_ptr<MindMap> map;
-    std::shared_ptr<Node> selectedNode;  // Primary selected node
-    std::vector<std::shared_ptr<Node>> selectedNodes;  // Multiple selected nodes
+    Selection selection; // Selected nodes and the primary one
     MindMapDrawer drawer;
+
+    // Rubber-band selection rectangle in screen coordinates, drawn over the cached
+    // tiles so dragging it does not render the map again
+    struct Marquee {
+        bool active = false;
+        double x0 = 0.0, y0 = 0.0, x1 = 0.0, y1 = 0.0;
+    };
+    Marquee m_marquee;
+
+    // Rendered map tiles; nodes that move or change appearance damage the tiles under them
+    TileCache m_tiles{E4Maps::TILE_SIZE, E4Maps::TILE_CACHE_MAX_BYTES};
+    std::vector<SpatialIndex::Rect> m_damage;
+
+    // World rectangles that changed since the last frame and have not been handed to
+    // the widget as repaint areas yet (see takeScreenDamage)
+    std::vector<SpatialIndex::Rect> m_repaint;
+    bool m_repaintAll = false;
+
+    // Layered drag: while branches are dragged the rest of the map does not change, so
+    // it is rendered once into a static layer and the branches into a moving layer.
+    // A frame composites the two, with only the connections into the dragged branches
+    // drawn live. Bounds of the dragged nodes are refreshed once, when the drag ends.
+    struct DragLayers {
+        bool active = false;
+        std::vector<std::shared_ptr<Node>> branches; // Roots of the dragged branches
+        std::vector<int> depths;
+        double startX = 0.0, startY = 0.0; // Where branches[0] was when the layers were made
+        Viewport viewport;
+        int width = 0, height = 0;
+        Cairo::RefPtr<Cairo::Surface> staticLayer;
+        Cairo::RefPtr<Cairo::Surface> movingLayer;
+        Gdk::Rectangle movingRect; // Screen area of the moving layer before any motion
+        Gdk::Rectangle lastArea;   // What the last motion drew over the static layer
+    };
+    DragLayers m_drag;
+
+    // Background tile rendering. Workers draw from a private copy of the map (the
+    // scene), taken when a frame first hands tiles over and dropped whenever tiles are
+    // invalidated, so they never touch the live nodes, theme or text layouts.
+    // Scene nodes are copy-on-write: a new scene copies only the nodes that changed
+    // since the last one and their ancestors, and shares every other subtree with the
+    // scenes before it. Nothing writes to a node once a scene holds it, and shared
+    // nodes have no parent.
+    struct TileScene {
+        uint64_t id = 0;
+        std::shared_ptr<Node> root;
+        Theme theme;         // Detached: shares no pattern with the map's theme
+        Selection selection; // Holds the copied nodes
+        DetailThresholds detail;
+    };
+    // Posted by the workers: a rendered tile, or an empty surface for a skipped job
+    struct TileResult {
+        TileCache::Key key;
+        uint64_t ticket = 0;
+        Cairo::RefPtr<Cairo::Surface> surface;
+        size_t bytes = 0;
+    };
+    std::shared_ptr<const TileScene> m_tileScene;
+    uint64_t m_tileSceneCount = 0;
+    std::unordered_map<int, std::shared_ptr<Node>> m_sceneCopies; // Node id -> latest copy in a scene
+    std::unordered_map<int, std::weak_ptr<Node>> m_sceneStale;    // Live nodes changed since, by id
+    double m_tileScale = 0.0; // Zoom the queued jobs were requested for
+    std::atomic<uint64_t> m_tileGeneration{0}; // Bumped to skip every queued job
+    Glib::Dispatcher m_tileDispatcher;
+    std::mutex m_tileResultsMutex;
+    std::vector<TileResult> m_tileResults; // Guarded by m_tileResultsMutex
+    std::function<void()> m_redrawCallback;
+    std::unique_ptr<ThreadPool> m_tilePool = std::make_unique<ThreadPool>();
+
+    // Text measurement of large maps, on the render workers. The UI thread takes the
+    // text and fonts of every node; workers shape them in chunks, each with a layout of
+    // its own thread, and the sizes are applied in one go when the last chunk is done.
+    // Until then nodes keep the size they had, or an estimate when they never had one.
+    struct MeasureJob {
+        std::vector<MindMapDrawer::TextMeasurement> texts; // Chunks are written by one worker each
+        Cairo::FontOptions fontOptions; // Of the widget, so sizes match what is drawn
+        std::atomic<size_t> pendingChunks{0};
+        std::atomic<bool> cancel{false};
+    };
+    std::shared_ptr<MeasureJob> m_measureJob; // Latest job, until applied
+    std::vector<std::shared_ptr<Node>> m_measureNodes; // Its nodes in pre-order, matching texts
+    std::vector<int> m_measureDepths;
+    Glib::Dispatcher m_measureDispatcher;
     
     // Threading
+    // Every global re-layout is a job tagged with a generation number. Starting a new
+    // one asks the older ones to stop; whatever they still deliver is dropped, so only
+    // the layout of the latest edit is ever applied.
+    struct LayoutJob {
+        uint64_t generation = 0;
+        const LayoutAlgorithms::LayoutEngine* engine = nullptr;
+        std::shared_ptr<std::atomic<bool>> cancel;
+        std::thread thread;
+    };
+    // Posted by the workers: a position snapshot, or the end of a job
+    struct LayoutMessage {
+        uint64_t generation = 0;
+        LayoutAlgorithms::LayoutSnapshot snapshot;
+        bool finished = false;
+        LayoutAlgorithms::ForceLayoutStats stats; // Only set when finished
+    };
     Glib::Dispatcher m_dispatcher;
-    std::thread m_workerThread;
-    std::atomic<bool> m_isCalculating{false};
-    std::shared_ptr<Node> m_calculatedRoot;
-    std::function<void()> m_redrawCallback;
-    bool m_dimensions_dirty = true; // New dirty flag
+    std::vector<LayoutJob> m_layoutJobs; // Running or finished but not yet joined
+    uint64_t m_layoutGeneration = 0;
+    std::mutex m_layoutMessagesMutex;
+    std::vector<LayoutMessage> m_layoutMessages; // Guarded by m_layoutMessagesMutex
+
+    // Nodes of the latest job in pre-order (snapshot index -> node), and the positions
+    // they are being animated towards
+    std::vector<std::shared_ptr<Node>> m_layoutTargets;
+    std::vector<double> m_targetX, m_targetY;
+    std::vector<char> m_isAnimating;
+    std::vector<int> m_animating; // Indices with m_isAnimating set
+    std::function<void()> m_animationCallback;
+    std::function<void(const LayoutAlgorithms::ForceLayoutStats&)> m_layoutFinishedCallback;
+
+    // Some node may need measuring (see Node::markSizeDirty); with m_measureAll, every node
+    bool m_dimensions_dirty = true;
+    bool m_measureAll = true;
+    uint64_t m_measuredThemeRevision = 0; // Theme the sizes were measured with
+    uint64_t m_measuredNodes = 0;         // Nodes measured so far, for benchmarks
+    size_t m_lastMeasuredNodes = 0;       // Nodes the last measuring pass took
+    LayoutAlgorithms::LayoutEngineRegistry m_layoutEngines;
+    LayoutAlgorithms::ForceLayoutOptions m_layoutOptions;
+    LayoutAlgorithms::ForceLayoutStats m_lastLayoutStats;
 
 public:
-    DrawingContext(std::shared_ptr<MindMap> m) : map(m), selectedNode(m->root) {
-        if (m->root) {
-            selectedNodes.push_back(m->root);
-        }
-        m_dispatcher.connect(sigc::mem_fun(*this, &DrawingContext::onLayoutFinished));
+    DrawingContext(std::shared_ptr<MindMap> m) : map(m) {
+        setSelectedNode(m->root);
+        m_dispatcher.connect(sigc::mem_fun(*this, &DrawingContext::onLayoutMessages));
+        m_tileDispatcher.connect(sigc::mem_fun(*this, &DrawingContext::onTileResults));
+        m_measureDispatcher.connect(sigc::mem_fun(*this, &DrawingContext::onMeasurementDone));
     }
     
     ~DrawingContext() {
-        if (m_workerThread.joinable()) {
-            m_workerThread.detach();
+        // Workers capture 'this', so they must be gone before any member is
+        cancelLayoutJobs();
+        for (auto& job : m_layoutJobs) {
+            if (job.thread.joinable()) job.thread.join();
         }
+        m_tileGeneration++; // Queued tiles are skipped while the pool drains
+        cancelMeasurement();
+        m_tilePool.reset();
     }
     
+    // Called when nodes start moving towards new layout positions; the owner then
+    // drives advanceLayoutAnimation() from its frame clock
+    void setAnimationCallback(std::function<void()> cb) {
+        m_animationCallback = cb;
+    }
+
+    // Called with the statistics of every layout of the latest edit that completes
+    void setLayoutFinishedCallback(std::function<void(const LayoutAlgorithms::ForceLayoutStats&)> cb) {
+        m_layoutFinishedCallback = cb;
+    }
+
+    // Called when tiles rendered in the background are ready to be shown
     void setRedrawCallback(std::function<void()> cb) {
         m_redrawCallback = cb;
     }
 
+    // Node sizes on screen at which drawing drops to simplified and overview detail
+    void setDetailThresholds(const DetailThresholds& thresholds) {
+        drawer.setDetailThresholds(thresholds);
+        m_tiles.invalidateAll(); // Kept as placeholders until redrawn
+        m_tileScene.reset();
+        m_repaintAll = true;
+    }
+
+    const LayoutAlgorithms::LayoutEngineRegistry& getLayoutEngines() const {
+        return m_layoutEngines;
+    }
+
+    // Engine pinned to the map, or the one the registry picks for its size
+    const LayoutAlgorithms::LayoutEngine* activeLayoutEngine(size_t nodeCount) const {
+        if (map) {
+            if (const auto* pinned = m_layoutEngines.find(map->layoutEngine)) return pinned;
+        }
+        return m_layoutEngines.choose(nodeCount, E4Maps::LAYOUT_TIME_BUDGET_MS);
+    }
+
+    // Pins an engine to the map ("" = automatic) and lays the map out again with it
+    void setLayoutEngine(const std::string& id) {
+        if (!map) return;
+        map->layoutEngine = id;
+        invalidateLayout();
+    }
+
+    // Options used by the background force-directed pass (kernel, thread count, ...)
+    void setLayoutOptions(const LayoutAlgorithms::ForceLayoutOptions& options) {
+        m_layoutOptions = options;
+    }
+
+    // Statistics of the last background force-directed pass that was applied
+    const LayoutAlgorithms::ForceLayoutStats& getLastLayoutStats() const {
+        return m_lastLayoutStats;
+    }
+
+    // Nodes measured since the context was made, and by the last measuring pass
+    uint64_t getMeasuredNodeCount() const { return m_measuredNodes; }
+    size_t getLastMeasuredNodeCount() const { return m_lastMeasuredNodes; }
+
     void setMap(std::shared_ptr<MindMap> m) {
+        m_drag = DragLayers();
+        cancelMeasurement();
         map = m;
-        selectedNode = m->root;
+        m_tiles.clear(); // Nothing of the old map is worth showing, not even as a placeholder
+        m_tileScene.reset();
+        m_sceneCopies.clear();
+        m_sceneStale.clear();
+        m_tileGeneration++;
+        setSelectedNode(m->root);
         viewport = Viewport(); 
-        if (map && map->root) {
-             LayoutAlgorithms::calculateImprovedRadialLayout(map->root, 0, 0, 0, 2*M_PI, 0);
+        if (map && map->root && !map->root->manualPosition) {
+            map->root->x = 0;
+            map->root->y = 0;
         }
         m_dimensions_dirty = true; // Mark dimensions as dirty when map changes
+        m_measureAll = true;
+        if (map) map->invalidateBounds(); // Index and boxes belong to the old map
         invalidateLayout(); 
     }
     
+    // Drops every cached text layout and measures the nodes again; for changes the
+    // layouts cannot see themselves, such as the font resolution
+    void invalidateTextLayouts() {
+        if (!map || !map->root) return;
+        MindMapDrawer::invalidateTextLayouts(map->root);
+        m_measureAll = true;
+        invalidateLayout();
+    }
+
     void invalidateLayout() {
         if (!map || !map->root) return;
+        endLayeredDrag(); // The layers would show the old layout
         m_dimensions_dirty = true;
 
-        // Apply radial layout immediately for a fast, good starting point
-        // This avoids nodes overlapping while the background calculation runs
-        // Use current root position to avoid snapping the view
-        LayoutAlgorithms::calculateImprovedRadialLayout(map->root, map->root->x, map->root->y, 0, 2*M_PI, 0);
+        // Supersede whatever is still running instead of waiting for it
+        cancelLayoutJobs();
+        uint64_t generation = ++m_layoutGeneration;
+        resetLayoutTargets();
 
-        if (m_isCalculating) return; 
+        // Let the engine give the map a fast, rough shape (the force engines: a radial
+        // layout around the current root position) while the background calculation runs
+        const auto* engine = activeLayoutEngine(m_layoutTargets.size());
+        std::vector<std::pair<double, double>> seeded;
+        seeded.reserve(m_layoutTargets.size());
+        for (const auto& node : m_layoutTargets) seeded.push_back({node->x, node->y});
+        engine->seed(map->root);
+        for (size_t i = 0; i < m_layoutTargets.size(); i++) {
+            Node& node = *m_layoutTargets[i];
+            if (node.x != seeded[i].first || node.y != seeded[i].second) map->updateNodeBounds(node);
+        }
 
-        m_isCalculating = true;
-        
         auto clone = cloneNodeTree(map->root);
-        int w = 4096;
-        int h = 4096;
 
-        if (m_workerThread.joinable()) m_workerThread.join();
+        LayoutJob job;
+        job.generation = generation;
+        job.engine = engine;
+        job.cancel = std::make_shared<std::atomic<bool>>(false);
+
+        // The flag lives in m_layoutJobs until the thread has been joined
+        auto options = m_layoutOptions;
+        options.cancel = job.cancel.get();
 
-        m_workerThread = std::thread([this, clone, w, h]() {
-            LayoutAlgorithms::calculateForceDirectedLayout(clone, w, h);
-            this->m_calculatedRoot = clone;
-            this->m_dispatcher.emit();
+        options.snapshotEveryMs = E4Maps::LAYOUT_SNAPSHOT_INTERVAL_MS;
+        options.onSnapshot = [this, generation](LayoutAlgorithms::LayoutSnapshot&& snapshot) {
+            LayoutMessage message;
+            message.generation = generation;
+            message.snapshot = std::move(snapshot);
+            postLayoutMessage(std::move(message));
+        };
+
+        job.thread = std::thread([this, clone, engine, options, generation]() {
+            LayoutMessage done;
+            done.generation = generation;
+            done.finished = true;
+            done.stats = engine->run(clone, options);
+            // Most engines see points, not boxes: clear what is left of the overlaps
+            if (!done.stats.cancelled && !options.cancel->load()) {
+                LayoutAlgorithms::removeOverlaps(clone, options.onSnapshot);
+            }
+            postLayoutMessage(std::move(done));
         });
+        m_layoutJobs.push_back(std::move(job));
     }
-    
-    void onLayoutFinished() {
-        if (m_workerThread.joinable()) m_workerThread.join();
-        m_isCalculating = false;
 
-        if (m_calculatedRoot && map && map->root) {
-            applyLayout(map->root, m_calculatedRoot);
-            m_calculatedRoot.reset();
-            
-            if (m_redrawCallback) m_redrawCallback();
+    // True while the layout of the latest edit is still being computed
+    bool isLayoutPending() const {
+        for (const auto& job : m_layoutJobs) {
+            if (job.generation == m_layoutGeneration) return true;
         }
+        return false;
     }
-    
-    void applyLayout(std::shared_ptr<Node> original, std::shared_ptr<Node> computed) {
-        std::map<int, std::pair<double, double>> posMap;
-        collectPositions(computed, posMap);
-        applyPositionsRecursive(original, posMap);
+
+    void cancelLayoutJobs() {
+        for (auto& job : m_layoutJobs) job.cancel->store(true);
     }
-    
-    void collectPositions(std::shared_ptr<Node> node, std::map<int, std::pair<double, double>>& map) {
-        if(!node) return;
-        map[node->id] = {node->x, node->y};
-        for(auto& child : node->children) collectPositions(child, map);
-    }
-
-    void applyPositionsRecursive(std::shared_ptr<Node> node, const std::map<int, std::pair<double, double>>& map) {
-        if(!node) return;
-        auto it = map.find(node->id);
-        if (it != map.end()) {
-            if (!node->manualPosition) { 
-                node->x = it->second.first;
-                node->y = it->second.second;
-            }
+
+    // Worker side: queue a message and wake the UI thread
+    void postLayoutMessage(LayoutMessage&& message) {
+        {
+            std::lock_guard<std::mutex> lock(m_layoutMessagesMutex);
+            m_layoutMessages.push_back(std::move(message));
         }
-        for(auto& child : node->children) applyPositionsRecursive(child, map);
+        m_dispatcher.emit();
     }
 
-    void setSelectedNode(std::shared_ptr<Node> node) {
-        selectedNode = node;
-        // Also update the selectedNodes vector to ensure this node is selected
-        if (node) {
-            selectedNodes.clear();
-            selectedNodes.push_back(node);
-        } else {
-            selectedNodes.clear();
+    // Pre-order list of the tree the next job will lay out, matching snapshot indices
+    void resetLayoutTargets() {
+        m_layoutTargets.clear();
+        std::vector<std::shared_ptr<Node>> stack{map->root};
+        while (!stack.empty()) {
+            auto node = stack.back();
+            stack.pop_back();
+            m_layoutTargets.push_back(node);
+            for (auto it = node->children.rbegin(); it != node->children.rend(); ++it) stack.push_back(*it);
         }
+        m_targetX.assign(m_layoutTargets.size(), 0.0);
+        m_targetY.assign(m_layoutTargets.size(), 0.0);
+        m_isAnimating.assign(m_layoutTargets.size(), 0);
+        m_animating.clear();
     }
 
-    std::shared_ptr<Node> getSelectedNode() const { return selectedNode; }
+    // Moves every animating node part of the way towards its target. O(moving nodes).
+    // Returns true while some node is still on its way.
+    bool advanceLayoutAnimation(double seconds) {
+        // The drag's static layer shows the nodes where they are: hold them until the
+        // drag ends, endLayeredDrag picks the animation up again
+        if (m_drag.active) return false;
+        double alpha = 1.0 - std::exp(-std::max(seconds, 0.0) / E4Maps::LAYOUT_ANIMATION_TIME_CONSTANT);
+        size_t kept = 0;
+        for (int index : m_animating) {
+            Node& node = *m_layoutTargets[index];
+            // The user grabbed it meanwhile
+            if (node.manualPosition) {
+                m_isAnimating[index] = 0;
+                continue;
+            }
+            double dx = m_targetX[index] - node.x;
+            double dy = m_targetY[index] - node.y;
+            if (std::abs(dx) < 0.5 && std::abs(dy) < 0.5) {
+                node.x = m_targetX[index];
+                node.y = m_targetY[index];
+                map->updateNodeBounds(node);
+                m_isAnimating[index] = 0;
+                continue;
+            }
+            node.x += dx * alpha;
+            node.y += dy * alpha;
+            map->updateNodeBounds(node);
+            m_animating[kept++] = index;
+        }
+        m_animating.resize(kept);
+        return !m_animating.empty();
+    }
 
-    // Multi-selection methods
-    void setSelectedNodes(const std::vector<std::shared_ptr<Node>>& nodes) {
-        selectedNodes = nodes;
-        if (!nodes.empty()) {
-            selectedNode = nodes[0]; // Set primary selection to first node
+    // Puts every animating node straight onto its target
+    void finishLayoutAnimation() {
+        for (int index : m_animating) {
+            Node& node = *m_layoutTargets[index];
+            if (!node.manualPosition) {
+                node.x = m_targetX[index];
+                node.y = m_targetY[index];
+                map->updateNodeBounds(node);
+            }
+            m_isAnimating[index] = 0;
         }
+        m_animating.clear();
     }
 
-    void addNodeToSelection(std::shared_ptr<Node> node) {
-        if (node) {
-            // Check if node is already in selection
-            auto it = std::find(selectedNodes.begin(), selectedNodes.end(), node);
-            if (it == selectedNodes.end()) {
-                // Only set as primary if no selection existed before
-                if (selectedNodes.empty()) {
-                    selectedNode = node; // Set as primary if it's the first selection
+    bool isLayoutAnimating() const { return !m_animating.empty(); }
+    
+    // Re-layout after an edit below 'changed' (e.g. a child was added to it).
+    // Only that subtree and its neighbourhood are touched, synchronously; the global
+    // pass runs instead when the edit is not local enough.
+    void invalidateLayout(std::shared_ptr<Node> changed) {
+        if (!map || !map->root) return;
+        endLayeredDrag(); // The layers would show the old layout
+
+        // A global pass in flight would overwrite the local result when it lands.
+        // m_layoutTargets is only refreshed by global passes, so size the map itself.
+        const auto* engine = activeLayoutEngine(map->nodeCount());
+        if (changed && !isLayoutPending() && engine->supportsIncremental()) {
+            finishLayoutAnimation(); // Start from where the last global pass put things
+            estimateSubtreeSizes(changed);
+            auto result = LayoutAlgorithms::calculateIncrementalLayout(*map, changed, m_layoutOptions);
+            if (result.applied) {
+                for (auto& node : result.nodes) map->updateNodeBounds(*node);
+                if (result.overlaps > static_cast<size_t>(E4Maps::INCREMENTAL_LAYOUT_OVERLAP_BUDGET)) {
+                    // Too crowded to settle locally; snapshot indices follow the current tree
+                    resetLayoutTargets();
+                    LayoutAlgorithms::removeOverlaps(map->root, [this](LayoutAlgorithms::LayoutSnapshot&& snapshot) {
+                        for (int index : snapshot.indices) map->updateNodeBounds(*m_layoutTargets[index]);
+                    });
                 }
-                selectedNodes.push_back(node);
+                m_lastLayoutStats = result.force;
+                if (m_layoutFinishedCallback) m_layoutFinishedCallback(m_lastLayoutStats);
+                m_dimensions_dirty = true;
+                return;
             }
         }
+        invalidateLayout();
+    }
+    
+    // Gives the nodes below 'subtree' that still wait for measuring an estimated size, so
+    // a layout that runs before the measurement sees roughly the right boxes
+    void estimateSubtreeSizes(const std::shared_ptr<Node>& subtree) {
+        int depth = 0;
+        for (auto p = subtree->parent.lock(); p; p = p->parent.lock()) depth++;
+        std::vector<std::pair<Node*, int>> stack{{subtree.get(), depth}};
+        while (!stack.empty()) {
+            auto [node, nodeDepth] = stack.back();
+            stack.pop_back();
+            if (node->sizeDirty || node->width <= 0.0) drawer.estimateNodeDimensions(*node, nodeDepth, map->theme);
+            for (auto& child : node->children) stack.push_back({child.get(), nodeDepth + 1});
+        }
     }
 
-    void removeNodeFromSelection(std::shared_ptr<Node> node) {
-        if (node) {
-            auto it = std::find(selectedNodes.begin(), selectedNodes.end(), node);
-            if (it != selectedNodes.end()) {
-                selectedNodes.erase(it);
-                // Update primary selection
-                if (selectedNode == node && !selectedNodes.empty()) {
-                    selectedNode = selectedNodes[0];
-                } else if (selectedNodes.empty()) {
-                    selectedNode = nullptr;
+    // UI side of the layout jobs: snapshots of the latest generation become animation
+    // targets, finished jobs are joined
+    void onLayoutMessages() {
+        std::vector<LayoutMessage> messages;
+        {
+            std::lock_guard<std::mutex> lock(m_layoutMessagesMutex);
+            messages.swap(m_layoutMessages);
+        }
+
+        bool moved = false;
+        for (auto& message : messages) {
+            if (message.finished) {
+                // The end message is the last thing a worker does, so joining is immediate
+                auto it = std::find_if(m_layoutJobs.begin(), m_layoutJobs.end(),
+                                       [&](const LayoutJob& job) { return job.generation == message.generation; });
+                if (it != m_layoutJobs.end()) {
+                    if (it->thread.joinable()) it->thread.join();
+                    // Keeps the automatic engine choice in line with this machine
+                    m_layoutEngines.recordRun(*it->engine, message.stats);
+                    m_layoutJobs.erase(it);
+                }
+                if (message.generation == m_layoutGeneration && !message.stats.cancelled) {
+                    m_lastLayoutStats = message.stats;
+                    if (m_layoutFinishedCallback) m_layoutFinishedCallback(m_lastLayoutStats);
+                }
+                continue;
+            }
+
+            // Outdated generations describe a tree that has changed since
+            if (message.generation != m_layoutGeneration) continue;
+
+            const auto& snapshot = message.snapshot;
+            for (size_t k = 0; k < snapshot.indices.size(); k++) {
+                int index = snapshot.indices[k];
+                if (index < 0 || static_cast<size_t>(index) >= m_layoutTargets.size()) continue;
+                if (m_layoutTargets[index]->manualPosition) continue;
+                m_targetX[index] = snapshot.x[k];
+                m_targetY[index] = snapshot.y[k];
+                if (!m_isAnimating[index]) {
+                    m_isAnimating[index] = 1;
+                    m_animating.push_back(index);
                 }
+                moved = true;
             }
         }
+
+        if (moved && m_animationCallback) m_animationCallback();
+    }
+
+    void setSelectedNode(std::shared_ptr<Node> node) {
+        damageSelection();
+        selection.clear();
+        selection.add(node);
+        damageNode(node);
+    }
+
+    std::shared_ptr<Node> getSelectedNode() const { return selection.primaryNode(); }
+
+    // Makes an already selected node primary, keeping the rest of the selection
+    void setPrimarySelectedNode(std::shared_ptr<Node> node) {
+        selection.setPrimary(node);
+        damageNode(node);
+    }
+
+    // Multi-selection methods
+    void setSelectedNodes(const std::vector<std::shared_ptr<Node>>& nodes) {
+        damageSelection();
+        selection.clear();
+        selection.reserve(nodes.size());
+        for (const auto& node : nodes) selection.add(node); // First node becomes primary
+        damageSelection();
+    }
+
+    void addNodeToSelection(std::shared_ptr<Node> node) {
+        if (selection.add(node)) damageNode(node);
+    }
+
+    void removeNodeFromSelection(std::shared_ptr<Node> node) {
+        if (selection.remove(node)) damageNode(node);
     }
 
     void clearSelection() {
-        selectedNodes.clear();
-        selectedNode = nullptr;
+        damageSelection();
+        selection.clear();
     }
 
     bool isNodeSelected(std::shared_ptr<Node> node) const {
-        if (!node) return false;
-        return std::find(selectedNodes.begin(), selectedNodes.end(), node) != selectedNodes.end();
+        return selection.contains(node);
+    }
+
+    // Selects the nodes whose box intersects the given world rectangle, in pre-order.
+    // additive keeps the current selection (and its primary node).
+    void selectNodesInRect(double minX, double minY, double maxX, double maxY, bool additive) {
+        if (!map) return;
+        auto nodes = map->nodesInRect(minX, minY, maxX, maxY);
+        if (!additive) clearSelection();
+        selection.reserve(selection.size() + nodes.size());
+        for (auto& node : nodes) {
+            if (selection.add(node)) damageNode(node);
+        }
     }
 
-    const std::vector<std::shared_ptr<Node>>& getSelectedNodes() const { return selectedNodes; }
-    size_t getSelectedNodesCount() const { return selectedNodes.size(); }
+    const std::vector<std::shared_ptr<Node>>& getSelectedNodes() const { return selection.nodes(); }
+    size_t getSelectedNodesCount() const { return selection.size(); }
 
     const Viewport& getViewport() const { return viewport; }
 
@@ -228,34 +597,693 @@ public:
         }
 
         if (m_dimensions_dirty) {
-            drawer.preCalculateNodeDimensions(map->root, map->theme, cr);
+            measureNodes(cr);
             m_dimensions_dirty = false;
         }
 
-        cr->save();
-        cr->translate(width/2.0 + viewport.offsetX, height/2.0 + viewport.offsetY);
+        if (m_drag.active) {
+            if (drawDragLayers(cr, width, height)) return true;
+            endLayeredDrag(); // The view changed under the layers
+        }
+
+        // This frame repaints whatever was asked for, damage included
+        applyBoundsDamage();
+        m_repaint.clear();
+        m_repaintAll = false;
+
+        if (isLayoutAnimating()) {
+            // Nearly every node moves each frame, tiles would not outlive the frame
+            drawMap(cr, width, height);
+        } else {
+            drawTiles(cr, width, height);
+        }
+
+        if (m_marquee.active) drawMarquee(cr);
+        return true;
+    }
+
+    // True until every node has been measured since the last change, i.e. while some
+    // node may still be drawn at a provisional size
+    bool areDimensionsPending() const {
+        return m_dimensions_dirty || m_measureJob != nullptr;
+    }
+
+    // Screen rectangles covering everything that changed since the last frame (old and
+    // new place of moved nodes with their connections and labels, restyled nodes), with
+    // the tiles under them already invalidated. Returns false when the whole widget
+    // needs repainting instead: sizes not measured yet, a layout animation running, or
+    // a structural change.
+    bool takeScreenDamage(int width, int height, std::vector<Gdk::Rectangle>& out) {
+        if (!map || !map->root || areDimensionsPending() || isLayoutAnimating()) return false;
+        applyBoundsDamage();
+        if (m_repaintAll) {
+            m_repaint.clear();
+            m_repaintAll = false;
+            return false;
+        }
+
+        size_t first = out.size();
+        Gdk::Rectangle widget(0, 0, width, height);
+        for (const auto& rect : m_repaint) {
+            Gdk::Rectangle area = screenRect(rect, width, height);
+            bool visible = false;
+            area.intersect(widget, visible);
+            if (visible) out.push_back(area);
+        }
+        m_repaint.clear();
+
+        // A big move damages many small areas; their bounding box is cheaper to track
+        if (out.size() - first > E4Maps::MAX_DAMAGE_RECTS) {
+            Gdk::Rectangle merged = out[first];
+            for (size_t i = first + 1; i < out.size(); i++) merged.join(out[i]);
+            out.resize(first);
+            out.push_back(merged);
+        }
+        return true;
+    }
+
+    // Starts a layered drag of the given branch roots (none of them inside another).
+    // createSurface makes offscreen surfaces like the widget's. Returns false, leaving
+    // the ordinary drawing in charge, when the map is not ready for it.
+    bool beginLayeredDrag(const std::vector<std::shared_ptr<Node>>& branches, int width, int height,
+                          const std::function<Cairo::RefPtr<Cairo::Surface>(Cairo::Content, int, int)>& createSurface) {
+        endLayeredDrag();
+        if (!map || !map->root || branches.empty() || areDimensionsPending() || width <= 0 || height <= 0) return false;
+        finishLayoutAnimation();
+        applyBoundsDamage(); // Fresh subtree boxes for the moving layer
+
+        DragLayers drag;
+        drag.branches = branches;
+        drag.startX = branches.front()->x;
+        drag.startY = branches.front()->y;
+        drag.viewport = viewport;
+        drag.width = width;
+        drag.height = height;
+
+        std::unordered_set<int> hidden;
+        bool rootDragged = false;
+        SpatialIndex::Rect moving = branches.front()->subtreeBounds;
+        for (const auto& branch : branches) {
+            int depth = 0;
+            for (auto parent = branch->parent.lock(); parent; parent = parent->parent.lock()) depth++;
+            drag.depths.push_back(depth);
+            hidden.insert(branch->id);
+            if (branch == map->root) rootDragged = true;
+
+            const auto& box = branch->subtreeBounds;
+            moving = {std::min(moving.minX, box.minX), std::min(moving.minY, box.minY),
+                      std::max(moving.maxX, box.maxX), std::max(moving.maxY, box.maxY)};
+        }
+
+        // The moving layer covers the branches, but no more than a screen beyond the
+        // widget on each side: a huge branch would not fit a surface
+        Gdk::Rectangle rect = screenRect(moving, width, height);
+        Gdk::Rectangle reach(-width, -height, 3 * width, 3 * height);
+        bool visible = false;
+        rect.intersect(reach, visible);
+        if (!visible) rect = Gdk::Rectangle(0, 0, 1, 1);
+        drag.movingRect = rect;
+
+        drag.staticLayer = createSurface(Cairo::CONTENT_COLOR, width, height);
+        drag.movingLayer = createSurface(Cairo::CONTENT_COLOR_ALPHA, rect.get_width(), rect.get_height());
+        if (!drag.staticLayer || !drag.movingLayer) return false;
+
+        auto cr = Cairo::Context::create(drag.staticLayer);
+        cr->set_source_rgb(1, 1, 1);
+        cr->paint();
+        if (!rootDragged) {
+            cr->translate(width/2.0 + viewport.offsetX, height/2.0 + viewport.offsetY);
+            cr->scale(viewport.scale, viewport.scale);
+            drawer.drawNode(cr, map->root, 0, map->theme, &selection, &hidden);
+        }
+
+        cr = Cairo::Context::create(drag.movingLayer);
+        cr->translate(width/2.0 + viewport.offsetX - rect.get_x(), height/2.0 + viewport.offsetY - rect.get_y());
         cr->scale(viewport.scale, viewport.scale);
+        for (size_t i = 0; i < drag.branches.size(); i++) {
+            drawer.drawNode(cr, drag.branches[i], drag.depths[i], map->theme, &selection);
+        }
+
+        drag.active = true;
+        m_drag = std::move(drag);
+        m_drag.lastArea = dragArea(); // The first motion repaints where the branches were
+        return true;
+    }
+
+    bool isLayeredDragActive() const { return m_drag.active; }
+
+    // Screen area to repaint after the dragged branches moved: where the moving layer
+    // and the live connections were drawn last time and where they go now
+    Gdk::Rectangle layeredDragDamage() {
+        if (!m_drag.active) return Gdk::Rectangle(0, 0, 0, 0);
+        Gdk::Rectangle area = dragArea();
+        Gdk::Rectangle damage = area;
+        damage.join(m_drag.lastArea);
+        m_drag.lastArea = area;
+        return damage;
+    }
+
+    // Back to ordinary drawing; the dragged nodes get their bounds refreshed, so their
+    // old and new places become damage
+    void endLayeredDrag() {
+        if (!m_drag.active) return;
+        auto branches = std::move(m_drag.branches);
+        m_drag = DragLayers();
+
+        std::vector<std::shared_ptr<Node>> stack(branches.begin(), branches.end());
+        while (!stack.empty()) {
+            auto node = std::move(stack.back());
+            stack.pop_back();
+            if (map) map->updateNodeBounds(*node);
+            for (const auto& child : node->children) stack.push_back(child);
+        }
+        if (!m_animating.empty() && m_animationCallback) m_animationCallback(); // Held during the drag
+    }
 
+    // Screen-space rubber-band rectangle shown over the map
+    void setMarquee(double x0, double y0, double x1, double y1) {
+        m_marquee = {true, x0, y0, x1, y1};
+    }
+
+    void clearMarquee() {
+        m_marquee.active = false;
+    }
+
+    // Screen area the marquee covers, stroke included (empty when there is none)
+    Gdk::Rectangle marqueeScreenRect() const {
+        if (!m_marquee.active) return Gdk::Rectangle(0, 0, 0, 0);
+        int left = (int)std::floor(std::min(m_marquee.x0, m_marquee.x1)) - 2;
+        int top = (int)std::floor(std::min(m_marquee.y0, m_marquee.y1)) - 2;
+        int right = (int)std::ceil(std::max(m_marquee.x0, m_marquee.x1)) + 2;
+        int bottom = (int)std::ceil(std::max(m_marquee.y0, m_marquee.y1)) + 2;
+        return Gdk::Rectangle(left, top, right - left, bottom - top);
+    }
+
+private:
+    void drawMap(const Cairo::RefPtr<Cairo::Context>& cr, int width, int height) {
+        cr->save();
         cr->set_source_rgb(1, 1, 1);
         cr->paint();
 
+        cr->translate(width/2.0 + viewport.offsetX, height/2.0 + viewport.offsetY);
+        cr->scale(viewport.scale, viewport.scale);
+
         // Drawing is now decoupled from heavy layout calculation.
         // Layout happens in background thread.
 
-        drawer.drawNode(cr, map->root, 0, map->theme, selectedNode, selectedNodes);
+        // drawNode skips whole branches whose cached box is off-screen
+        drawer.drawNode(cr, map->root, 0, map->theme, &selection);
 
         cr->restore();
+    }
+
+    // Whole screen pixels covering a world rectangle, plus one: tiles and layers are
+    // blitted at rounded positions
+    Gdk::Rectangle screenRect(const SpatialIndex::Rect& rect, int width, int height) const {
+        double originX = width/2.0 + viewport.offsetX;
+        double originY = height/2.0 + viewport.offsetY;
+        int left = (int)std::floor(originX + rect.minX * viewport.scale) - 1;
+        int top = (int)std::floor(originY + rect.minY * viewport.scale) - 1;
+        int right = (int)std::ceil(originX + rect.maxX * viewport.scale) + 1;
+        int bottom = (int)std::ceil(originY + rect.maxY * viewport.scale) + 1;
+        return Gdk::Rectangle(left, top, right - left, bottom - top);
+    }
+
+    // Moving layer offset by how far the branches moved, and the live connections
+    Gdk::Rectangle dragArea() const {
+        int shiftX = (int)std::round((m_drag.branches.front()->x - m_drag.startX) * viewport.scale);
+        int shiftY = (int)std::round((m_drag.branches.front()->y - m_drag.startY) * viewport.scale);
+        Gdk::Rectangle area(m_drag.movingRect.get_x() + shiftX, m_drag.movingRect.get_y() + shiftY,
+                            m_drag.movingRect.get_width(), m_drag.movingRect.get_height());
+
+        DrawExtents extents = drawer.drawExtents(map->theme);
+        for (size_t i = 0; i < m_drag.branches.size(); i++) {
+            const auto& branch = m_drag.branches[i];
+            auto parent = branch->parent.lock();
+            if (!parent) continue;
+            area.join(screenRect(connectionBounds(*parent, *branch, m_drag.depths[i] - 1, extents),
+                                 m_drag.width, m_drag.height));
+        }
+        return area;
+    }
+
+    // Returns false when the layers no longer match the view
+    bool drawDragLayers(const Cairo::RefPtr<Cairo::Context>& cr, int width, int height) {
+        if (width != m_drag.width || height != m_drag.height || viewport.scale != m_drag.viewport.scale ||
+            viewport.offsetX != m_drag.viewport.offsetX || viewport.offsetY != m_drag.viewport.offsetY) {
+            return false;
+        }
+
+        cr->set_source(m_drag.staticLayer, 0, 0);
+        cr->paint();
+
+        // Connections into the branches, with their parent drawn again over the start
+        cr->save();
+        cr->translate(width/2.0 + viewport.offsetX, height/2.0 + viewport.offsetY);
+        cr->scale(viewport.scale, viewport.scale);
+        SpatialIndex::Rect clip;
+        cr->get_clip_extents(clip.minX, clip.minY, clip.maxX, clip.maxY);
+        double pixelScale = MindMapDrawer::pixelScale(cr);
+        for (size_t i = 0; i < m_drag.branches.size(); i++) {
+            const auto& branch = m_drag.branches[i];
+            auto parent = branch->parent.lock();
+            if (!parent) continue;
+            const NodeStyle& style = drawer.resolveStyle(*parent, m_drag.depths[i] - 1, map->theme);
+            drawer.drawConnection(cr, parent, branch, m_drag.depths[i] - 1, style, drawer.detailLevel(*branch, pixelScale));
+            drawer.drawNodeBox(cr, parent, style, &selection, clip, drawer.detailLevel(*parent, pixelScale));
+        }
+        cr->restore();
+
+        int shiftX = (int)std::round((m_drag.branches.front()->x - m_drag.startX) * viewport.scale);
+        int shiftY = (int)std::round((m_drag.branches.front()->y - m_drag.startY) * viewport.scale);
+        cr->set_source(m_drag.movingLayer, m_drag.movingRect.get_x() + shiftX, m_drag.movingRect.get_y() + shiftY);
+        cr->paint();
         return true;
     }
 
+    // Refreshes the subtree bounds and invalidates the tiles under whatever moved since
+    // the last call; the changed areas are queued for repainting
+    void applyBoundsDamage() {
+        map->refreshSubtreeBounds(drawer.drawExtents(map->theme));
+        std::vector<std::weak_ptr<Node>> changed;
+        if (map->takeChangedNodes(changed)) {
+            m_sceneCopies.clear(); // The next scene is copied in full
+            m_sceneStale.clear();
+        }
+        for (const auto& weak : changed) {
+            if (auto node = weak.lock()) m_sceneStale[node->id] = node;
+        }
+        if (map->takeBoundsDamage(m_damage)) {
+            m_tiles.invalidateAll();
+            m_tileScene.reset();
+            m_repaintAll = true;
+        } else if (!m_damage.empty()) {
+            for (const auto& rect : m_damage) m_tiles.invalidate(rect.minX, rect.minY, rect.maxX, rect.maxY);
+            m_tileScene.reset();
+            m_repaint.insert(m_repaint.end(), m_damage.begin(), m_damage.end());
+        }
+        m_damage.clear();
+    }
+
+    // Blits the cached tiles covering the area being redrawn. Tiles live in the pixel
+    // space of the current scale, anchored at a whole pixel so they are copied 1:1; the
+    // sub-pixel part of the pan offset is dropped.
+    // A few missing tiles (after an edit or during a drag) are rendered right away;
+    // when more are missing they go to the render workers and placeholders are shown.
+    void drawTiles(const Cairo::RefPtr<Cairo::Context>& cr, int width, int height) {
+        const int size = m_tiles.tileSize();
+        double originX = std::round(width/2.0 + viewport.offsetX);
+        double originY = std::round(height/2.0 + viewport.offsetY);
+
+        if (viewport.scale != m_tileScale) {
+            m_tileScale = viewport.scale;
+            m_tileGeneration++; // Tiles queued for the previous zoom are not wanted any more
+        }
+
+        double clipX1, clipY1, clipX2, clipY2;
+        cr->get_clip_extents(clipX1, clipY1, clipX2, clipY2);
+        int tx0 = (int)std::floor((clipX1 - originX) / size);
+        int ty0 = (int)std::floor((clipY1 - originY) / size);
+        int tx1 = (int)std::ceil((clipX2 - originX) / size) - 1;
+        int ty1 = (int)std::ceil((clipY2 - originY) / size) - 1;
+
+        std::vector<TileCache::Key> missing;
+        for (int ty = ty0; ty <= ty1; ty++) {
+            for (int tx = tx0; tx <= tx1; tx++) {
+                TileCache::Key key{viewport.scale, tx, ty};
+                if (!m_tiles.find(key) && !m_tiles.isRequested(key)) missing.push_back(key);
+            }
+        }
+        if (missing.size() <= E4Maps::TILE_SYNC_RENDER_LIMIT) {
+            for (const auto& key : missing) renderTile(cr, key);
+        } else {
+            double deviceScaleX = 1.0, deviceScaleY = 1.0;
+            cr->get_target()->get_device_scale(deviceScaleX, deviceScaleY);
+            for (const auto& key : missing) requestTile(key, deviceScaleX);
+        }
+
+        for (int ty = ty0; ty <= ty1; ty++) {
+            for (int tx = tx0; tx <= tx1; tx++) {
+                TileCache::Key key{viewport.scale, tx, ty};
+                double x = originX + tx * size;
+                double y = originY + ty * size;
+                if (auto tile = m_tiles.find(key)) {
+                    cr->set_source(tile, x, y);
+                    cr->rectangle(x, y, size, size);
+                    cr->fill();
+                } else {
+                    drawPlaceholder(cr, key, originX, originY);
+                }
+            }
+        }
+    }
+
+    // Stands in for a tile the workers are still rendering: its stale self, or the
+    // tiles of the nearest zoom level that has any, stretched over it
+    void drawPlaceholder(const Cairo::RefPtr<Cairo::Context>& cr, const TileCache::Key& key, double originX, double originY) {
+        const int size = m_tiles.tileSize();
+        cr->save();
+        cr->rectangle(originX + key.tx * size, originY + key.ty * size, size, size);
+        cr->clip();
+        cr->set_source_rgb(1, 1, 1);
+        cr->paint();
+
+        if (auto stale = m_tiles.findAny(key)) {
+            cr->set_source(stale, originX + key.tx * size, originY + key.ty * size);
+            cr->paint();
+        } else if (double other = m_tiles.nearestScale(key.scale); other > 0.0) {
+            // Only up to 4x either way: beyond that it is a blur or too many tiles
+            double ratio = key.scale / other;
+            if (ratio >= 0.25 && ratio <= 4.0) {
+                cr->translate(originX, originY);
+                cr->scale(ratio, ratio);
+                int ux0 = (int)std::floor(key.tx / ratio);
+                int uy0 = (int)std::floor(key.ty / ratio);
+                int ux1 = (int)std::ceil((key.tx + 1) / ratio) - 1;
+                int uy1 = (int)std::ceil((key.ty + 1) / ratio) - 1;
+                for (int uy = uy0; uy <= uy1; uy++) {
+                    for (int ux = ux0; ux <= ux1; ux++) {
+                        auto tile = m_tiles.findAny(TileCache::Key{other, ux, uy});
+                        if (!tile) continue;
+                        cr->set_source(tile, ux * size, uy * size);
+                        cr->paint();
+                    }
+                }
+            }
+        }
+        cr->restore();
+    }
+
+    static void paintTile(const Cairo::RefPtr<Cairo::Context>& cr, const TileCache::Key& key, int size,
+                          MindMapDrawer& drawer, const std::shared_ptr<Node>& root,
+                          const Theme& theme, const Selection& selection) {
+        cr->set_source_rgb(1, 1, 1);
+        cr->paint();
+        cr->translate(-key.tx * size, -key.ty * size);
+        cr->scale(key.scale, key.scale);
+        drawer.drawNode(cr, root, 0, theme, &selection); // Clipped to the tile
+    }
+
+    void renderTile(const Cairo::RefPtr<Cairo::Context>& cr, const TileCache::Key& key) {
+        const int size = m_tiles.tileSize();
+        // Similar surface: same backend and device scale as the window
+        auto tile = Cairo::Surface::create(cr->get_target(), Cairo::CONTENT_COLOR, size, size);
+        paintTile(Cairo::Context::create(tile), key, size, drawer, map->root, map->theme, selection);
 
+        double scaleX = 1.0, scaleY = 1.0;
+        tile->get_device_scale(scaleX, scaleY);
+        m_tiles.insert(key, tile, (size_t)(size * size * 4 * scaleX * scaleY));
+    }
+
+    // Copy of everything a tile is drawn from, by value
+    std::shared_ptr<const TileScene> makeTileScene() {
+        auto scene = std::make_shared<TileScene>();
+        scene->id = ++m_tileSceneCount;
+        // Changed nodes and their ancestors get new copies
+        std::unordered_set<const Node*> stale;
+        for (const auto& [id, weak] : m_sceneStale) {
+            for (auto node = weak.lock(); node && stale.insert(node.get()).second; node = node->parent.lock()) {}
+        }
+        m_sceneStale.clear();
+        scene->root = sceneCopy(map->root, stale);
+        scene->theme = map->theme.detachedCopy();
+        scene->detail = drawer.detailThresholds();
+
+        for (const auto& node : selection.nodes()) {
+            auto it = m_sceneCopies.find(node->id);
+            if (it != m_sceneCopies.end()) scene->selection.add(it->second); // Same ids as the originals
+        }
+        return scene;
+    }
+
+    // The scene copy of a live subtree: the last one made, unless the node is stale
+    // or has never been copied. Copies of removed nodes stay behind until the next
+    // full copy (see applyBoundsDamage).
+    std::shared_ptr<Node> sceneCopy(const std::shared_ptr<Node>& live, const std::unordered_set<const Node*>& stale) {
+        auto it = m_sceneCopies.find(live->id);
+        if (it != m_sceneCopies.end() && !stale.count(live.get())) return it->second;
+
+        auto copy = copyNode(*live);
+        copy->children.reserve(live->children.size());
+        for (const auto& child : live->children) copy->children.push_back(sceneCopy(child, stale));
+        m_sceneCopies[live->id] = copy;
+        return copy;
+    }
+
+    void requestTile(const TileCache::Key& key, double deviceScale) {
+        if (!m_tileScene) m_tileScene = makeTileScene();
+        uint64_t ticket = m_tiles.request(key);
+        uint64_t generation = m_tileGeneration.load();
+        int size = m_tiles.tileSize();
+        auto scene = m_tileScene;
+
+        m_tilePool->submit([this, scene, key, ticket, generation, size, deviceScale]() {
+            TileResult result;
+            result.key = key;
+            result.ticket = ticket;
+            if (generation == m_tileGeneration.load()) {
+                int pixels = (int)std::ceil(size * deviceScale);
+                result.surface = rasterizeTile(*scene, key, size, deviceScale);
+                result.bytes = (size_t)pixels * pixels * 4;
+            }
+            {
+                std::lock_guard<std::mutex> lock(m_tileResultsMutex);
+                m_tileResults.push_back(std::move(result));
+            }
+            m_tileDispatcher.emit();
+        });
+    }
+
+    // Worker side: draws one tile of the scene into an image surface of its own
+    static Cairo::RefPtr<Cairo::Surface> rasterizeTile(const TileScene& scene, const TileCache::Key& key,
+                                                       int size, double deviceScale) {
+        // Per worker thread: a drawer that leaves the shared nodes alone, and a copy of
+        // the theme whose patterns no other thread references
+        struct WorkerState {
+            uint64_t sceneId = 0;
+            Theme theme;
+            MindMapDrawer drawer;
+        };
+        thread_local WorkerState state;
+        if (state.sceneId != scene.id) {
+            state.theme = scene.theme.detachedCopy();
+            state.drawer.setLayoutCaching(false);
+            state.drawer.setDetailThresholds(scene.detail);
+            state.sceneId = scene.id;
+        }
+
+        int pixels = (int)std::ceil(size * deviceScale);
+        auto surface = Cairo::ImageSurface::create(Cairo::FORMAT_RGB24, pixels, pixels);
+        surface->set_device_scale(deviceScale, deviceScale);
+        paintTile(Cairo::Context::create(surface), key, size, state.drawer, scene.root, state.theme, scene.selection);
+        surface->flush();
+        return surface;
+    }
+
+    // Gives the nodes whose size is stale their size. A few nodes are measured right
+    // here; many go to the workers, so a huge map does not hold up its first frame.
+    void measureNodes(const Cairo::RefPtr<Cairo::Context>& cr) {
+        cancelMeasurement();
+        bool all = m_measureAll || map->theme.revision() != m_measuredThemeRevision;
+        m_measureAll = false;
+        m_measuredThemeRevision = map->theme.revision();
+
+        // Only the marked paths, unless everything is stale. A node measured at another
+        // depth takes its subtree along, their styles follow the depth.
+        struct Item {
+            std::shared_ptr<Node> node;
+            int depth;
+            bool force;
+        };
+        std::vector<Item> stack{{map->root, 0, all}};
+        while (!stack.empty()) {
+            Item item = std::move(stack.back());
+            stack.pop_back();
+            Node& node = *item.node;
+            if (!item.force && !node.subtreeSizeDirty) continue;
+
+            bool moved = node.measuredDepth != item.depth;
+            if (item.force || moved || node.sizeDirty) {
+                m_measureNodes.push_back(item.node);
+                m_measureDepths.push_back(item.depth);
+            }
+            node.sizeDirty = false;
+            node.subtreeSizeDirty = false;
+            node.measuredDepth = item.depth;
+            for (auto it = node.children.rbegin(); it != node.children.rend(); ++it) {
+                stack.push_back({*it, item.depth + 1, item.force || moved});
+            }
+        }
+        m_lastMeasuredNodes = m_measureNodes.size();
+        m_measuredNodes += m_measureNodes.size();
+        if (m_measureNodes.empty()) return;
+
+        if (m_measureNodes.size() < E4Maps::ASYNC_MEASURE_MIN_NODES) {
+            std::vector<std::shared_ptr<Node>> resized;
+            for (size_t i = 0; i < m_measureNodes.size(); i++) {
+                Node& node = *m_measureNodes[i];
+                double width = node.width, height = node.height;
+                drawer.calculateNodeDimensions(m_measureNodes[i], map->theme, cr, m_measureDepths[i]);
+                map->updateNodeBounds(node);
+                if (node.width != width || node.height != height) resized.push_back(m_measureNodes[i]);
+            }
+            m_measureNodes.clear();
+            m_measureDepths.clear();
+            onNodesResized(resized);
+            return;
+        }
+
+        auto job = std::make_shared<MeasureJob>();
+        job->texts.reserve(m_measureNodes.size());
+        for (size_t i = 0; i < m_measureNodes.size(); i++) {
+            Node& node = *m_measureNodes[i];
+            job->texts.push_back(drawer.textMeasurement(node, m_measureDepths[i], map->theme));
+            if (node.width <= 0.0) {
+                drawer.estimateNodeDimensions(node, m_measureDepths[i], map->theme);
+                map->updateNodeBounds(node);
+            }
+        }
+        cr->get_target()->get_font_options(job->fontOptions);
+
+        size_t count = job->texts.size();
+        size_t chunks = (count + E4Maps::MEASURE_CHUNK_NODES - 1) / E4Maps::MEASURE_CHUNK_NODES;
+        job->pendingChunks = chunks;
+        m_measureJob = job;
+        for (size_t c = 0; c < chunks; c++) {
+            size_t begin = c * E4Maps::MEASURE_CHUNK_NODES;
+            size_t end = std::min(count, begin + E4Maps::MEASURE_CHUNK_NODES);
+            m_tilePool->submit([this, job, begin, end]() {
+                measureTexts(*job, begin, end);
+                // The last chunk hands the job over; a cancelled one is simply dropped
+                if (--job->pendingChunks == 0 && !job->cancel.load()) m_measureDispatcher.emit();
+            });
+        }
+    }
+
+    // Drops the job in flight; its nodes are marked to be measured by the next one
+    void cancelMeasurement() {
+        if (m_measureJob) m_measureJob->cancel = true;
+        for (const auto& node : m_measureNodes) node->markSizeDirty();
+        m_measureJob.reset();
+        m_measureNodes.clear();
+        m_measureDepths.clear();
+    }
+
+    // Worker side: measures texts [begin, end) of a job
+    static void measureTexts(MeasureJob& job, size_t begin, size_t end) {
+        // Per worker thread: a layout on the thread's own default font map, reused for
+        // every text it measures
+        struct MeasureState {
+            Cairo::RefPtr<Cairo::Context> cr;
+            Glib::RefPtr<Pango::Layout> layout;
+        };
+        thread_local MeasureState state;
+        if (!state.layout) {
+            state.cr = Cairo::Context::create(Cairo::ImageSurface::create(Cairo::FORMAT_ARGB32, 1, 1));
+            state.layout = Pango::Layout::create(state.cr);
+        }
+        state.cr->set_font_options(job.fontOptions);
+        state.layout->update_from_cairo_context(state.cr);
+
+        for (size_t i = begin; i < end; i++) {
+            if (job.cancel.load()) return;
+            MindMapDrawer::measureText(state.layout, job.texts[i]);
+        }
+    }
+
+    // The layout placed these nodes with the size they had before measuring. A layout
+    // still running works on those sizes too and starts over; otherwise the resized
+    // nodes are moved off whatever they now overlap.
+    void onNodesResized(const std::vector<std::shared_ptr<Node>>& resized) {
+        if (resized.empty()) return;
+        endLayeredDrag(); // The layers show the old sizes and places
+        if (isLayoutPending()) {
+            invalidateLayout();
+            return;
+        }
+        finishLayoutAnimation(); // Its targets were computed with the old sizes
+        LayoutAlgorithms::removeOverlaps(*map, resized);
+    }
+
+    // UI side of the measurement: every node of the finished job gets its size at once
+    void onMeasurementDone() {
+        auto job = m_measureJob;
+        if (!job || job->pendingChunks.load() != 0) return; // Emitted by an older job
+        endLayeredDrag(); // The layers show the provisional sizes
+        std::vector<std::shared_ptr<Node>> resized;
+        for (size_t i = 0; i < m_measureNodes.size(); i++) {
+            Node& node = *m_measureNodes[i];
+            double width = node.width, height = node.height;
+            drawer.applyTextMeasurement(node, m_measureDepths[i], map->theme, job->texts[i]);
+            map->updateNodeBounds(node);
+            if (node.width != width || node.height != height) resized.push_back(m_measureNodes[i]);
+        }
+        m_measureJob.reset();
+        m_measureNodes.clear();
+        m_measureDepths.clear();
+        onNodesResized(resized);
+        m_tiles.invalidateAll(); // Kept as placeholders until redrawn
+        m_tileScene.reset();
+        m_repaintAll = true;
+        if (m_redrawCallback) m_redrawCallback();
+    }
+
+    // UI side of the render workers: tiles still wanted go into the cache
+    void onTileResults() {
+        std::vector<TileResult> results;
+        {
+            std::lock_guard<std::mutex> lock(m_tileResultsMutex);
+            results.swap(m_tileResults);
+        }
+
+        bool delivered = false;
+        for (auto& result : results) {
+            if (m_tiles.deliver(result.key, result.ticket, result.surface, result.bytes)) delivered = true;
+        }
+        if (delivered && m_redrawCallback) m_redrawCallback();
+    }
+
+    // A node's selection state only changes how the node box itself is painted
+    void damageNode(const std::shared_ptr<Node>& node) {
+        if (!node || !map) return;
+        double margin = drawer.drawExtents(map->theme).nodeMargin; // Shadow and border included
+        SpatialIndex::Rect box{node->x - node->width/2 - margin, node->y - node->height/2 - margin,
+                               node->x + node->width/2 + margin, node->y + node->height/2 + margin};
+        m_tiles.invalidate(box.minX, box.minY, box.maxX, box.maxY);
+        m_tileScene.reset();
+        m_repaint.push_back(box);
+    }
+
+    void damageSelection() {
+        for (const auto& node : selection.nodes()) damageNode(node);
+    }
+
+    void drawMarquee(const Cairo::RefPtr<Cairo::Context>& cr) const {
+        double x = std::min(m_marquee.x0, m_marquee.x1);
+        double y = std::min(m_marquee.y0, m_marquee.y1);
+        double w = std::abs(m_marquee.x1 - m_marquee.x0);
+        double h = std::abs(m_marquee.y1 - m_marquee.y0);
+
+        cr->save();
+        // Same blue as the border of selected nodes
+        cr->rectangle(std::floor(x) + 0.5, std::floor(y) + 0.5, std::round(w), std::round(h));
+        cr->set_source_rgba(0.2, 0.6, 1.0, 0.15);
+        cr->fill_preserve();
+        cr->set_source_rgb(0.2, 0.6, 1.0);
+        cr->set_line_width(1.0);
+        cr->stroke();
+        cr->restore();
+    }
+
+public:
 
     void centerView(int width, int height) {
-        double minX, minY, maxX, maxY;
-        if (MindMapUtils::calculateMapBounds(map->root, minX, minY, maxX, maxY)) {
-            double contentCenterX = (minX + maxX) / 2.0;
-            double contentCenterY = (minY + maxY) / 2.0;
-            double contentWidth = maxX - minX; double contentHeight = maxY - minY;
+        if (map && map->root) {
+            // Cached subtree bounds: fitting the view on every resize does not walk the map
+            const auto& bounds = map->refreshSubtreeBounds(drawer.drawExtents(map->theme));
+            double contentCenterX = (bounds.minX + bounds.maxX) / 2.0;
+            double contentCenterY = (bounds.minY + bounds.maxY) / 2.0;
+            double contentWidth = bounds.maxX - bounds.minX; double contentHeight = bounds.maxY - bounds.minY;
             double scaleX = width / (contentWidth + 100);
             double scaleY = height / (contentHeight + 100);
             double newScale = std::min(scaleX, scaleY);
@@ -275,9 +1303,17 @@ public:
     }
 
     std::shared_ptr<Node> hitTest(double screenX, double screenY, int width, int height) {
+        if (!map) return nullptr;
         auto [worldX, worldY] = screenToWorld(screenX, screenY, width, height);
         return map->hitTest(worldX, worldY);
     }
+
+    // Keeps hit-testing in step with a node moved outside of the layout (e.g. dragged).
+    // During a layered drag this waits for endLayeredDrag, which refreshes every dragged node.
+    void updateNodeBounds(Node& node) {
+        if (m_drag.active) return;
+        if (map) map->updateNodeBounds(node);
+    }
 };
 
 #endif // DRAWING_CONTEXT_HPP
\ No newline at end of file
@@ -20,10 +20,13 @@ class Exporter {
     int width;
     int height;
     MindMapDrawer drawer; // Instance of MindMapDrawer
+    LayoutAlgorithms::LayoutEngineRegistry layoutEngines;
     const double PI = 3.14159265359;
 
 public:
-    Exporter(int w, int h) : width(w), height(h) {}
+    Exporter(int w, int h) : width(w), height(h) {
+        drawer.setDetailThresholds({0.0, 0.0}); // Exports are meant to be read up close
+    }
 
     void exportToPng(std::shared_ptr<MindMap> map, const std::string& filename, double dpi = 72.0) {
         // Calculate content bounds to determine canvas size
@@ -152,18 +155,22 @@ public:
             // If nodes have been manually positioned, respect their positions
             // No layout algorithm should be applied
         } else {
-            // Apply improved layout for better readability during export if no manual positions
-            // Use force-directed layout for complex maps for better readability in export
-            int nodeCount = countNodesInTree(map->root);
-            if (nodeCount > 20) {
-                // Use the force-directed algorithm for export with a large canvas
-                LayoutAlgorithms::calculateForceDirectedLayout(map->root, 4096, 4096);
-            } else {
-                // Apply improved radial layout for simpler maps
-                calculateImprovedRadialLayoutForExport(map->root);
-            }
+            // Apply the map's layout engine for better readability during export if no
+            // manual positions, or the nicest one that fits the time budget
+            const auto* engine = layoutEngines.find(map->layoutEngine);
+            if (!engine) engine = layoutEngines.choose(countNodesInTree(map->root), E4Maps::LAYOUT_TIME_BUDGET_MS);
+
+            // Start with the root at center
+            map->root->x = 0;
+            map->root->y = 0;
+            engine->seed(map->root);
+            engine->run(map->root, LayoutAlgorithms::ForceLayoutOptions());
+            LayoutAlgorithms::removeOverlaps(map->root);
         }
 
+        // Sizes (and maybe positions) changed above; drawNode culls with the cached boxes
+        map->invalidateBounds();
+        map->refreshSubtreeBounds(drawer.drawExtents(map->theme));
         drawer.drawNode(cr, map->root, 0, map->theme);
     }
 
@@ -188,27 +195,6 @@ public:
         }
         return count;
     }
-
-    // Calculate improved radial layout specifically for export
-    void calculateImprovedRadialLayoutForExport(std::shared_ptr<Node> node) {
-        if (!node) return;
-
-        // Start with the root at center if it doesn't have manual position
-        if (node->isRoot() && !node->manualPosition) {
-            node->x = 0;
-            node->y = 0;
-        }
-
-        // Use the improved algorithm for children, but respect manual positions
-        if (!node->children.empty()) {
-            LayoutAlgorithms::calculateImprovedRadialLayout(node, node->x, node->y, 0, 2*M_PI, 0);
-        }
-
-        // Recursively apply to all children
-        for (auto& child : node->children) {
-            calculateImprovedRadialLayoutForExport(child);
-        }
-    }
     
     // Helper methods for Freeplane export
 
@@ -1,7 +1,15 @@
 #include "LayoutAlgorithm.hpp"
+#include "Constants.hpp"
+#include "ThreadPool.hpp"
+#include "LayoutKernels.hpp"
+#include "Translation.hpp"
 #include <cmath>
 #include <algorithm>
 #include <functional>
+#include <chrono>
+#include <limits>
+#include <set>
+#include <unordered_set>
 
 namespace LayoutAlgorithms {
 
@@ -10,6 +18,9 @@ namespace LayoutAlgorithms {
                                        double startAngle, double endAngle, int depth) {
         if (!node) return;
 
+        node->sectorStart = startAngle;
+        node->sectorEnd = endAngle;
+
         if (node->isRoot() && !node->manualPosition) {
             node->x = cx;
             node->y = cy;
@@ -51,137 +62,1637 @@ namespace LayoutAlgorithms {
         }
     }
 
-    // Force-directed layout algorithm for better readability
-    struct LayoutNode {
-        std::shared_ptr<Node> node;
-        double x, y;
-        double fx, fy; // Forces
-        bool fixed;
+    namespace {
 
-        LayoutNode(std::shared_ptr<Node> n, double initialX, double initialY) 
-            : node(n), x(initialX), y(initialY), fx(0), fy(0), fixed(n->manualPosition) {}
-    };
+        // Workers of every force pass in the process. Started once: the multilevel engine
+        // runs a pass per level and the incremental layout one per edit.
+        ThreadPool& layoutPool() {
+            static ThreadPool pool;
+            return pool;
+        }
 
-    void calculateForceDirectedLayout(std::shared_ptr<Node> root, int width, int height) {
-        if (!root) return;
+        // Multilevel coarsening stops once a level has this few nodes...
+        constexpr size_t MULTILEVEL_COARSEST_SIZE = 50;
+        // ...or no longer shrinks below this fraction of the level above
+        constexpr double MULTILEVEL_MIN_SHRINK = 0.85;
+        // Iteration cap for every level but the coarsest: they start from a good layout
+        constexpr int MULTILEVEL_REFINE_ITERATIONS = 60;
+
+        // The tree below root in pre-order, the index order snapshots refer to
+        std::vector<std::shared_ptr<Node>> collectPreOrder(const std::shared_ptr<Node>& root) {
+            std::vector<std::shared_ptr<Node>> nodes;
+            std::vector<std::shared_ptr<Node>> pending{root};
+            while (!pending.empty()) {
+                auto node = pending.back();
+                pending.pop_back();
+                nodes.push_back(node);
+                for (auto it = node->children.rbegin(); it != node->children.rend(); ++it) pending.push_back(*it);
+            }
+            return nodes;
+        }
+
+        // Barnes-Hut quadtree over the current node positions.
+        // Every cell stores the mass and centre of mass of the nodes it contains, so a
+        // distant cell can stand in for all of them in a single interaction.
+        // Leaves keep a range into a permuted index array instead of a single body:
+        // coincident nodes (e.g. children that still sit on their parent) end up in the
+        // same leaf instead of forcing unbounded subdivision.
+        class BarnesHutTree {
+        public:
+            void build(const LayoutKernels::LayoutArrays& state) {
+                const size_t count = state.size();
+                cells.clear();
+                order.resize(count);
+                for (size_t i = 0; i < count; i++) order[i] = static_cast<int>(i);
+                if (count == 0) return;
+
+                double minX = state.x[0], maxX = state.x[0];
+                double minY = state.y[0], maxY = state.y[0];
+                for (size_t i = 1; i < count; i++) {
+                    minX = std::min(minX, state.x[i]); maxX = std::max(maxX, state.x[i]);
+                    minY = std::min(minY, state.y[i]); maxY = std::max(maxY, state.y[i]);
+                }
+
+                Cell root;
+                root.cx = (minX + maxX) / 2.0;
+                root.cy = (minY + maxY) / 2.0;
+                root.half = std::max(maxX - minX, maxY - minY) / 2.0 + 1.0;
+                cells.reserve(count * 2);
+                cells.push_back(root);
+                subdivide(state, 0, 0, static_cast<int>(count), 0);
+            }
+
+            // Adds the repulsion acting on node i to (fx, fy).
+            // Uses the same force law and cutoff as the exact kernel.
+            // Read-only, so several threads may query the same tree with their own stacks.
+            void accumulateRepulsion(const LayoutKernels::LayoutArrays& state, size_t i, double theta,
+                                     double repulsion, double cutoffSq, double& fx, double& fy,
+                                     std::vector<int>& stack) const {
+                if (cells.empty()) return;
+
+                const double px = state.x[i];
+                const double py = state.y[i];
+                const double thetaSq = theta * theta;
+
+                stack.clear();
+                stack.push_back(0);
+                while (!stack.empty()) {
+                    const Cell& cell = cells[stack.back()];
+                    stack.pop_back();
+
+                    // Skip cells that lie entirely beyond the cutoff radius
+                    double gapX = std::max(0.0, std::abs(px - cell.cx) - cell.half);
+                    double gapY = std::max(0.0, std::abs(py - cell.cy) - cell.half);
+                    if (gapX * gapX + gapY * gapY > cutoffSq) continue;
+
+                    if (cell.leaf) {
+                        for (int k = cell.begin; k < cell.end; k++) {
+                            size_t j = static_cast<size_t>(order[k]);
+                            if (j == i) continue;
+                            addRepulsion(px - state.x[j], py - state.y[j], state.massOf(j), repulsion, cutoffSq, fx, fy);
+                        }
+                        continue;
+                    }
+
+                    double dx = px - cell.comX;
+                    double dy = py - cell.comY;
+                    double distSq = dx * dx + dy * dy;
+                    double side = cell.half * 2.0;
+
+                    if (side * side < thetaSq * distSq) {
+                        // Far enough: the whole cell acts as one body at its centre of mass
+                        addRepulsion(dx, dy, cell.mass, repulsion, cutoffSq, fx, fy);
+                    } else {
+                        for (int c : cell.child) {
+                            if (c >= 0) stack.push_back(c);
+                        }
+                    }
+                }
+            }
+
+        private:
+            struct Cell {
+                double cx = 0.0, cy = 0.0, half = 0.0; // Square bounds (centre + half side)
+                double mass = 0.0;
+                double comX = 0.0, comY = 0.0;         // Centre of mass
+                int child[4] = {-1, -1, -1, -1};
+                int begin = 0, end = 0;                // Body range in 'order' (leaves only)
+                bool leaf = true;
+            };
+
+            static constexpr int LEAF_CAPACITY = 4;
+            static constexpr int MAX_DEPTH = 24;
+
+            std::vector<Cell> cells;
+            std::vector<int> order;
+
+            static void addRepulsion(double dx, double dy, double mass, double repulsion,
+                                     double cutoffSq, double& fx, double& fy) {
+                double distSq = dx * dx + dy * dy;
+                if (distSq > cutoffSq) return;
+
+                double distance = std::sqrt(distSq) + 0.1; // Avoid division by zero
+                double factor = repulsion * mass / (distance * distance * distance);
+                fx += factor * dx;
+                fy += factor * dy;
+            }
+
+            void subdivide(const LayoutKernels::LayoutArrays& state, int cellIndex, int begin, int end, int depth) {
+                // Note: 'cells' may reallocate while recursing, so always index instead of holding references
+                cells[cellIndex].begin = begin;
+                cells[cellIndex].end = end;
+
+                if (end - begin <= LEAF_CAPACITY || depth >= MAX_DEPTH) {
+                    double mass = 0.0, sumX = 0.0, sumY = 0.0;
+                    for (int k = begin; k < end; k++) {
+                        double m = state.massOf(order[k]);
+                        mass += m;
+                        sumX += state.x[order[k]] * m;
+                        sumY += state.y[order[k]] * m;
+                    }
+                    cells[cellIndex].mass = mass;
+                    cells[cellIndex].comX = sumX / mass;
+                    cells[cellIndex].comY = sumY / mass;
+                    return;
+                }
+
+                const double cx = cells[cellIndex].cx;
+                const double cy = cells[cellIndex].cy;
+                const double childHalf = cells[cellIndex].half / 2.0;
+                cells[cellIndex].leaf = false;
+
+                // Partition into quadrants: [top-left, top-right, bottom-left, bottom-right]
+                auto first = order.begin() + begin;
+                auto last = order.begin() + end;
+                auto midY = std::partition(first, last, [&](int j) { return state.y[j] < cy; });
+                auto midTop = std::partition(first, midY, [&](int j) { return state.x[j] < cx; });
+                auto midBottom = std::partition(midY, last, [&](int j) { return state.x[j] < cx; });
+
+                int bounds[5] = {
+                    begin,
+                    static_cast<int>(midTop - order.begin()),
+                    static_cast<int>(midY - order.begin()),
+                    static_cast<int>(midBottom - order.begin()),
+                    end
+                };
+
+                double mass = 0.0, sumX = 0.0, sumY = 0.0;
+                for (int q = 0; q < 4; q++) {
+                    if (bounds[q] == bounds[q + 1]) continue;
+
+                    Cell child;
+                    child.cx = cx + ((q & 1) ? childHalf : -childHalf);
+                    child.cy = cy + ((q & 2) ? childHalf : -childHalf);
+                    child.half = childHalf;
+                    int childIndex = static_cast<int>(cells.size());
+                    cells.push_back(child);
+                    cells[cellIndex].child[q] = childIndex;
+
+                    subdivide(state, childIndex, bounds[q], bounds[q + 1], depth + 1);
+
+                    const Cell& done = cells[childIndex];
+                    mass += done.mass;
+                    sumX += done.comX * done.mass;
+                    sumY += done.comY * done.mass;
+                }
+
+                cells[cellIndex].mass = mass;
+                cells[cellIndex].comX = sumX / mass;
+                cells[cellIndex].comY = sumY / mass;
+            }
+        };
+
+        // Spring adjacency in CSR form: the neighbours of node i are
+        // neighbours[neighbourStart[i] .. neighbourStart[i + 1])
+        void buildAdjacency(size_t count, const std::vector<std::pair<int, int>>& edges,
+                            std::vector<int>& neighbourStart, std::vector<int>& neighbours) {
+            neighbourStart.assign(count + 1, 0);
+            neighbours.resize(edges.size() * 2);
+            for (const auto& edge : edges) {
+                neighbourStart[edge.first + 1]++;
+                neighbourStart[edge.second + 1]++;
+            }
+            for (size_t i = 0; i < count; i++) neighbourStart[i + 1] += neighbourStart[i];
+            std::vector<int> fill(neighbourStart.begin(), neighbourStart.end() - 1);
+            for (const auto& edge : edges) {
+                neighbours[fill[edge.first]++] = edge.second;
+                neighbours[fill[edge.second]++] = edge.first;
+            }
+        }
+
+        // Force simulation on packed arrays, in place. Runs until the layout settles or
+        // options.maxIterations is reached and adds what it did to 'stats' (iterations
+        // accumulate, the rest describes this run).
+        // When state.mass is set, node j repels with strength mass[j] (the multilevel
+        // engine's super-nodes); that always goes through the Barnes-Hut tree.
+        // 'scale' stretches every length (spring rest length, cutoff, step, tolerance) so
+        // super-nodes of average mass m settle about sqrt(m) times further apart, as the
+        // nodes they stand for will need that much room.
+        void simulate(LayoutKernels::LayoutArrays& state, const std::vector<int>& neighbourStart,
+                      const std::vector<int>& neighbours, const ForceLayoutOptions& options,
+                      ForceLayoutStats& stats, double scale = 1.0) {
+            const size_t count = state.size();
+            if (count == 0) return;
+
+            // Force-directed algorithm parameters
+            const double k = 200.0 * scale * scale; // Spring constant (higher = further apart)
+            const double repulsion = 5000000.0; // Repulsion constant (much higher to combat overlap)
+            const double maxStep = std::max(options.initialStep, 0.0) * scale;
+            const double cooling = std::clamp(options.coolingFactor, 0.01, 0.999);
+            const double tolerance = options.displacementTolerance * scale;
+            double step = maxStep; // Max movement per iteration, adapted as the layout settles
+
+            // Performance: Ignore repulsion for distant nodes
+            const double cutoff = 800.0 * scale;
+            const double cutoffSq = cutoff * cutoff;
+
+            bool useBarnesHut = options.repulsion == RepulsionMethod::BarnesHut ||
+                                !state.mass.empty() ||
+                                (options.repulsion == RepulsionMethod::Auto &&
+                                 count > static_cast<size_t>(E4Maps::BARNES_HUT_THRESHOLD));
+            stats.usedBarnesHut = stats.usedBarnesHut || useBarnesHut;
+            BarnesHutTree tree;
+
+            // Small maps are not worth the synchronisation cost
+            size_t threadCount = count < static_cast<size_t>(E4Maps::PARALLEL_LAYOUT_MIN_NODES) ? 1 : options.threads;
+            ThreadPool& pool = layoutPool();
+
+            // Each worker owns a contiguous slice of the force/position arrays and sums every
+            // contribution for its nodes in a fixed order. No two threads touch the same node,
+            // so there is nothing to merge and the result is bit-identical for any thread count.
+            auto computeForces = [&](size_t begin, size_t end) {
+                std::fill(state.fx.begin() + begin, state.fx.begin() + end, 0.0);
+                std::fill(state.fy.begin() + begin, state.fy.begin() + end, 0.0);
+
+                // Repulsive forces
+                if (useBarnesHut) {
+                    std::vector<int> stack;
+                    for (size_t i = begin; i < end; i++) {
+                        if (state.isFixed(i)) continue;
+                        tree.accumulateRepulsion(state, i, options.theta, repulsion, cutoffSq,
+                                                 state.fx[i], state.fy[i], stack);
+                    }
+                } else {
+                    LayoutKernels::accumulateRepulsion(state, begin, end, repulsion, cutoffSq);
+                }
+
+                // Attractive forces towards parent and children
+                for (size_t i = begin; i < end; i++) {
+                    if (state.isFixed(i)) continue;
+
+                    double fx = 0.0, fy = 0.0;
+                    for (int e = neighbourStart[i]; e < neighbourStart[i + 1]; e++) {
+                        double dx = state.x[neighbours[e]] - state.x[i];
+                        double dy = state.y[neighbours[e]] - state.y[i];
+                        double distance = std::sqrt(dx * dx + dy * dy) + 0.1;
+
+                        double force = (distance * distance) / k; // Spring force
+                        fx += force * dx / distance;
+                        fy += force * dy / distance;
+                    }
+                    state.fx[i] += fx;
+                    state.fy[i] += fy;
+                }
+            };
+
+            auto updatePositions = [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; i++) {
+                    if (state.isFixed(i)) continue; // Don't move manually positioned nodes
+
+                    double displacement = std::sqrt(state.fx[i] * state.fx[i] + state.fy[i] * state.fy[i]);
+                    if (displacement > 0) {
+                        double factor = std::min(step, displacement) / displacement;
+                        state.x[i] += state.fx[i] * factor;
+                        state.y[i] += state.fy[i] * factor;
+                    }
+                }
+            };
+
+            double previousEnergy = -1.0;
+            int progress = 0;
+            int iteration = 0;
+
+            // Progressive output: positions as of the last snapshot, to send only what moved
+            std::vector<double> publishedX, publishedY;
+            if (options.onSnapshot) {
+                publishedX = state.x;
+                publishedY = state.y;
+            }
+            auto lastSnapshot = std::chrono::steady_clock::now();
+            auto publish = [&](bool final) {
+                // Sub-pixel moves are not worth a message until the final one
+                const double tolerance = final ? 0.0 : 0.5;
+                LayoutSnapshot snapshot;
+                snapshot.iteration = stats.iterations + iteration;
+                snapshot.final = final;
+                for (size_t i = 0; i < count; i++) {
+                    if (state.isFixed(i)) continue;
+                    if (std::abs(state.x[i] - publishedX[i]) <= tolerance &&
+                        std::abs(state.y[i] - publishedY[i]) <= tolerance) continue;
+                    publishedX[i] = state.x[i];
+                    publishedY[i] = state.y[i];
+                    snapshot.indices.push_back(static_cast<int>(i));
+                    snapshot.x.push_back(state.x[i]);
+                    snapshot.y.push_back(state.y[i]);
+                }
+                options.onSnapshot(std::move(snapshot));
+            };
+
+            stats.converged = false;
+            while (iteration < options.maxIterations) {
+                if (options.cancel && options.cancel->load(std::memory_order_relaxed)) {
+                    stats.cancelled = true;
+                    break;
+                }
+
+                // Fixed nodes are part of the tree (they still push others away) but never move
+                if (useBarnesHut) tree.build(state);
+
+                // All forces are computed from the previous positions before anything moves
+                pool.parallelFor(count, computeForces, threadCount);
+
+                // Energy and largest force are reduced serially in node order so the stopping
+                // point, like the positions, does not depend on the thread count
+                double energy = 0.0;
+                double maxForceSq = 0.0;
+                for (size_t i = 0; i < count; i++) {
+                    if (state.isFixed(i)) continue;
+                    double forceSq = state.fx[i] * state.fx[i] + state.fy[i] * state.fy[i];
+                    energy += forceSq;
+                    maxForceSq = std::max(maxForceSq, forceSq);
+                }
+
+                // A layout that is already close to equilibrium (e.g. re-run after a small edit)
+                // starts with a step no larger than its biggest force instead of shaking loose
+                if (iteration == 0) step = std::min(step, std::sqrt(maxForceSq));
+
+                pool.parallelFor(count, updatePositions, threadCount);
+                iteration++;
+
+                if (options.onSnapshot) {
+                    auto now = std::chrono::steady_clock::now();
+                    bool due = (options.snapshotEveryIterations > 0 &&
+                                iteration % options.snapshotEveryIterations == 0) ||
+                               (options.snapshotEveryMs > 0.0 &&
+                                std::chrono::duration<double, std::milli>(now - lastSnapshot).count() >= options.snapshotEveryMs);
+                    if (due) {
+                        publish(false);
+                        lastSnapshot = now;
+                    }
+                }
+                stats.finalEnergy = energy;
+                stats.finalStep = step;
+                stats.maxDisplacement = std::min(step, std::sqrt(maxForceSq));
+
+                bool settled = stats.maxDisplacement < tolerance;
+                if (previousEnergy > 0.0 &&
+                    std::abs(energy - previousEnergy) <= options.energyTolerance * previousEnergy) {
+                    settled = true;
+                }
+                if (settled) {
+                    stats.converged = true;
+                    break;
+                }
+
+                // Adaptive cooling (Hu 2005): speed back up while energy keeps falling,
+                // slow down as soon as it rises
+                if (previousEnergy < 0.0 || energy < previousEnergy) {
+                    if (++progress >= 5) {
+                        progress = 0;
+                        step = std::min(maxStep, step / cooling);
+                    }
+                } else {
+                    progress = 0;
+                    step *= cooling;
+                }
+                previousEnergy = energy;
+            }
+
+            stats.iterations += iteration;
+            if (options.onSnapshot && !stats.cancelled) publish(true);
+        }
+
+        // One level of the multilevel hierarchy
+        struct MultilevelLevel {
+            LayoutKernels::LayoutArrays state;
+            std::vector<int> parent;     // Parent (super-)node, -1 for the root's
+            std::vector<int> group;      // Super-node on the next coarser level
+            std::vector<double> startX, startY; // Positions before this level was simulated
+        };
+
+        // Collapses 'fine' into super-nodes and fills 'coarse'. Returns false when the tree
+        // no longer shrinks enough to be worth another level.
+        //  1. Every leaf joins its parent's super-node, so a node and all its leaf children
+        //     become one (fixed leaves stay on their own to keep their position).
+        //  2. Along chains, a node that absorbed nothing pairs up with a parent that did not
+        //     either.
+        // Super-nodes are connected subtrees, so the coarse level is still a tree.
+        bool coarsenLevel(MultilevelLevel& fine, MultilevelLevel& coarse) {
+            const size_t count = fine.state.size();
+            std::vector<int> childCount(count, 0);
+            for (size_t i = 0; i < count; i++) {
+                if (fine.parent[i] >= 0) childCount[fine.parent[i]]++;
+            }
+
+            // Nodes are in pre-order, so a parent always has its group before its children
+            std::vector<int> group(count, -1);
+            std::vector<int> groupSize;
+            for (size_t i = 0; i < count; i++) {
+                int p = fine.parent[i];
+                if (p >= 0 && childCount[i] == 0 && !fine.state.isFixed(i)) {
+                    group[i] = group[p];
+                } else {
+                    group[i] = static_cast<int>(groupSize.size());
+                    groupSize.push_back(0);
+                }
+                groupSize[group[i]]++;
+            }
+
+            std::vector<char> paired(groupSize.size(), 0);
+            for (size_t i = 0; i < count; i++) {
+                int p = fine.parent[i];
+                if (p < 0 || fine.state.isFixed(i)) continue;
+                int own = group[i], above = group[p];
+                if (own == above || groupSize[own] != 1 || groupSize[above] != 1 || paired[above]) continue;
+                group[i] = above;
+                paired[above] = 1;
+                paired[own] = 1; // Not available as a parent any more either
+            }
+
+            // Renumber the surviving groups in pre-order of their top node
+            std::vector<int> renumber(groupSize.size(), -1);
+            size_t coarseCount = 0;
+            for (size_t i = 0; i < count; i++) {
+                if (renumber[group[i]] < 0) renumber[group[i]] = static_cast<int>(coarseCount++);
+                group[i] = renumber[group[i]];
+            }
+            if (coarseCount == count ||
+                static_cast<double>(coarseCount) > MULTILEVEL_MIN_SHRINK * static_cast<double>(count)) {
+                return false;
+            }
+
+            coarse.state.resize(coarseCount);
+            coarse.state.mass.assign(coarseCount, 0.0);
+            coarse.parent.assign(coarseCount, -1);
+            std::vector<char> seen(coarseCount, 0);
+            for (size_t i = 0; i < count; i++) {
+                int g = group[i];
+                double m = fine.state.massOf(i);
+                coarse.state.mass[g] += m;
+
+                // A fixed member pins the whole super-node where it is
+                if (fine.state.isFixed(i)) {
+                    if (!coarse.state.isFixed(g)) {
+                        coarse.state.setFixed(g, true);
+                        coarse.state.x[g] = fine.state.x[i];
+                        coarse.state.y[g] = fine.state.y[i];
+                    }
+                } else if (!coarse.state.isFixed(g)) {
+                    coarse.state.x[g] += fine.state.x[i] * m;
+                    coarse.state.y[g] += fine.state.y[i] * m;
+                }
+
+                // The first member seen is the topmost one; its parent lies outside the group
+                if (!seen[g]) {
+                    seen[g] = 1;
+                    if (fine.parent[i] >= 0) coarse.parent[g] = group[fine.parent[i]];
+                }
+            }
+            for (size_t g = 0; g < coarseCount; g++) {
+                if (coarse.state.isFixed(g)) continue;
+                coarse.state.x[g] /= coarse.state.mass[g];
+                coarse.state.y[g] /= coarse.state.mass[g];
+            }
+
+            fine.group = std::move(group);
+            return true;
+        }
+
+        // Runs the force simulation over 'nodes' with springs along 'edges' and writes the
+        // final positions back. Nodes with pinned[i] set repel the others but never move.
+        ForceLayoutStats runForceSimulation(const std::vector<std::shared_ptr<Node>>& nodes,
+                                            const std::vector<std::pair<int, int>>& edges,
+                                            const std::vector<char>& pinned,
+                                            const ForceLayoutOptions& options) {
+            ForceLayoutStats stats;
+            const size_t count = nodes.size();
+            stats.nodeCount = count;
+            if (count == 0) return stats;
+            auto startTime = std::chrono::steady_clock::now();
+
+            LayoutKernels::LayoutArrays state;
+            state.resize(count);
+            for (size_t i = 0; i < count; i++) {
+                state.x[i] = nodes[i]->x; // Use existing position as initial
+                state.y[i] = nodes[i]->y;
+                state.setFixed(i, pinned[i] != 0);
+            }
+
+            // Springs are gathered per node (parent + children) instead of scattered per edge,
+            // so every node's force is written by exactly one thread.
+            std::vector<int> neighbourStart, neighbours;
+            buildAdjacency(count, edges, neighbourStart, neighbours);
+
+            simulate(state, neighbourStart, neighbours, options, stats);
+
+            // Update original nodes with new positions
+            for (size_t i = 0; i < count && !stats.cancelled; i++) {
+                nodes[i]->x = state.x[i];
+                nodes[i]->y = state.y[i];
+            }
+
+            stats.totalMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+            if (stats.iterations > 0) stats.msPerIteration = stats.totalMs / stats.iterations;
+            return stats;
+        }
+
+    } // namespace
+
+    ForceLayoutStats calculateForceDirectedLayout(std::shared_ptr<Node> root, int width, int height,
+                                                  const ForceLayoutOptions& options) {
+        if (!root) return ForceLayoutStats();
         
-        // Collect all nodes for the force-directed algorithm
-        std::vector<LayoutNode> layoutNodes;
+        // Collect all nodes for the force-directed algorithm.
+        // Node pointers are only needed to write the result back, so they live apart
+        // from the packed coordinates the inner loops work on.
+        std::vector<std::shared_ptr<Node>> nodes;
         std::vector<std::pair<int, int>> edges; // connections between nodes
+        std::vector<char> pinned;
         
         // Helper function to traverse and collect nodes
-        std::function<void(std::shared_ptr<Node>, int)> collectNodes = 
-            [&](std::shared_ptr<Node> node, int parentId) {
-                int currentIndex = layoutNodes.size();
-                
-                layoutNodes.emplace_back(
-                    node, 
-                    node->x,  // Use existing position as initial
-                    node->y
-                );
-                
+        std::function<void(std::shared_ptr<Node>)> collectNodes = 
+            [&](std::shared_ptr<Node> node) {
+                int currentIndex = nodes.size();
+                nodes.push_back(node);
                 // Force root to be fixed to stabilize the view during auto-layout
-                if (node->isRoot()) {
-                    layoutNodes.back().fixed = true;
-                }
+                pinned.push_back(node->manualPosition || node->isRoot());
                 
                 // Add edges for connections
                 for (auto& child : node->children) {
-                    collectNodes(child, currentIndex);
-                    edges.push_back({currentIndex, static_cast<int>(layoutNodes.size() - 1)});
+                    edges.push_back({currentIndex, static_cast<int>(nodes.size())});
+                    collectNodes(child);
                 }
             };
         
-        collectNodes(root, -1);
+        collectNodes(root);
+
+        return runForceSimulation(nodes, edges, pinned, options);
+    }
 
-        if (layoutNodes.empty()) return;
 
-        // Force-directed algorithm parameters
-        const double k = 200.0; // Spring constant (higher = further apart)
-        const double repulsion = 5000000.0; // Repulsion constant (much higher to combat overlap)
-        const double maxDisplacement = 50.0; // Max movement per iteration
-        const int iterations = 50;
+    ForceLayoutStats calculateMultilevelLayout(std::shared_ptr<Node> root, const ForceLayoutOptions& options) {
+        ForceLayoutStats stats;
+        if (!root) return stats;
+        auto startTime = std::chrono::steady_clock::now();
 
-        for (int iter = 0; iter < iterations; iter++) {
-            // Reset forces
-            for (auto& ln : layoutNodes) {
-                if (!ln.fixed) {
-                    ln.fx = 0;
-                    ln.fy = 0;
+        // Finest level: the tree itself in pre-order, so snapshot indices mean the same as
+        // with calculateForceDirectedLayout
+        std::vector<std::shared_ptr<Node>> nodes;
+        std::vector<MultilevelLevel> levels(1);
+        {
+            MultilevelLevel& finest = levels[0];
+            std::vector<std::pair<std::shared_ptr<Node>, int>> pending{{root, -1}};
+            while (!pending.empty()) {
+                auto [node, parentIndex] = pending.back();
+                pending.pop_back();
+                int index = static_cast<int>(nodes.size());
+                nodes.push_back(node);
+                finest.parent.push_back(parentIndex);
+                for (auto it = node->children.rbegin(); it != node->children.rend(); ++it) {
+                    pending.push_back({*it, index});
                 }
             }
 
-            // Calculate repulsive forces
-            double cutoff = 800.0; // Performance: Ignore repulsion for distant nodes
-            double cutoffSq = cutoff * cutoff;
+            finest.state.resize(nodes.size());
+            for (size_t i = 0; i < nodes.size(); i++) {
+                finest.state.x[i] = nodes[i]->x;
+                finest.state.y[i] = nodes[i]->y;
+                // Force root to be fixed to stabilize the view during auto-layout
+                finest.state.setFixed(i, nodes[i]->manualPosition || nodes[i]->isRoot());
+            }
+        }
+        stats.nodeCount = nodes.size();
 
-            for (size_t i = 0; i < layoutNodes.size(); i++) {
-                if (layoutNodes[i].fixed) continue;
-                
-                for (size_t j = 0; j < layoutNodes.size(); j++) {
-                    if (i == j) continue;
-                    
-                    double dx = layoutNodes[i].x - layoutNodes[j].x;
-                    double dy = layoutNodes[i].y - layoutNodes[j].y;
-                    double distSq = dx * dx + dy * dy;
-                    
-                    // Optimization: Skip far nodes
-                    if (distSq > cutoffSq) continue;
+        while (levels.back().state.size() > MULTILEVEL_COARSEST_SIZE) {
+            MultilevelLevel coarse;
+            if (!coarsenLevel(levels.back(), coarse)) break;
+            levels.push_back(std::move(coarse));
+        }
+        stats.levels = static_cast<int>(levels.size());
+
+        // Coarsest first, then prolong each result one level down and refine it there
+        for (size_t l = levels.size(); l-- > 0;) {
+            MultilevelLevel& level = levels[l];
+            const size_t count = level.state.size();
 
-                    double distance = std::sqrt(distSq) + 0.1; // Avoid division by zero
-                    
-                    // force = repulsion / dist^2
-                    // fx = force * (dx / dist) = repulsion * dx / dist^3
-                    double factor = repulsion / (distance * distance * distance);
-                    
-                    layoutNodes[i].fx += factor * dx;
-                    layoutNodes[i].fy += factor * dy;
+            if (l + 1 < levels.size()) {
+                // Every node follows its super-node, keeping its offset from it
+                const MultilevelLevel& coarse = levels[l + 1];
+                for (size_t i = 0; i < count; i++) {
+                    if (level.state.isFixed(i)) continue;
+                    int g = level.group[i];
+                    level.state.x[i] += coarse.state.x[g] - coarse.startX[g];
+                    level.state.y[i] += coarse.state.y[g] - coarse.startY[g];
                 }
             }
+            level.startX = level.state.x;
+            level.startY = level.state.y;
 
-            // Calculate attractive forces
-            for (const auto& edge : edges) {
-                auto& ln1 = layoutNodes[edge.first];
-                auto& ln2 = layoutNodes[edge.second];
-                
-                if (ln1.fixed && ln2.fixed) continue; // If both are fixed, no spring force
-                
-                double dx = ln2.x - ln1.x;
-                double dy = ln2.y - ln1.y;
-                double distance = std::sqrt(dx * dx + dy * dy) + 0.1;
-                
-                double force = (distance * distance) / k; // Spring force
-                double fx = force * dx / distance;
-                double fy = force * dy / distance;
-                
-                if (!ln1.fixed) {
-                    ln1.fx += fx;
-                    ln1.fy += fy;
+            std::vector<std::pair<int, int>> edges;
+            edges.reserve(count);
+            for (size_t i = 0; i < count; i++) {
+                if (level.parent[i] >= 0) edges.push_back({level.parent[i], static_cast<int>(i)});
+            }
+            std::vector<int> neighbourStart, neighbours;
+            buildAdjacency(count, edges, neighbourStart, neighbours);
+
+            ForceLayoutOptions levelOptions = options;
+            if (l + 1 < levels.size()) {
+                levelOptions.maxIterations = std::min(options.maxIterations, MULTILEVEL_REFINE_ITERATIONS);
+            }
+            // Snapshot indices only make sense on the finest level
+            if (l > 0) levelOptions.onSnapshot = nullptr;
+
+            double averageMass = 1.0;
+            if (!level.state.mass.empty()) {
+                averageMass = static_cast<double>(nodes.size()) / static_cast<double>(count);
+            }
+            simulate(level.state, neighbourStart, neighbours, levelOptions, stats, std::sqrt(averageMass));
+            if (stats.cancelled) break;
+        }
+
+        if (!stats.cancelled) {
+            const MultilevelLevel& finest = levels[0];
+            for (size_t i = 0; i < nodes.size(); i++) {
+                nodes[i]->x = finest.state.x[i];
+                nodes[i]->y = finest.state.y[i];
+            }
+        }
+
+        stats.totalMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+        if (stats.iterations > 0) stats.msPerIteration = stats.totalMs / stats.iterations;
+        return stats;
+    }
+
+    namespace {
+        size_t separateNodes(const std::vector<std::shared_ptr<Node>>& nodes, const std::vector<char>& fixed,
+                             std::vector<double>& x, std::vector<double>& y, size_t& constraintCount);
+        size_t countOverlaps(const std::vector<double>& x, const std::vector<double>& y,
+                             const std::vector<double>& halfW, const std::vector<double>& halfH);
+    } // namespace
+
+    IncrementalLayoutResult calculateIncrementalLayout(MindMap& map, std::shared_ptr<Node> changed,
+                                                       const ForceLayoutOptions& options) {
+        IncrementalLayoutResult result;
+        // The root's sector is the whole map, so there is nothing local about it
+        if (!map.root || !changed || changed->isRoot()) return result;
+        if (changed->sectorEnd <= changed->sectorStart) return result; // Never laid out radially
+
+        const size_t maxNodes = static_cast<size_t>(E4Maps::INCREMENTAL_LAYOUT_MAX_NODES);
+
+        std::vector<std::shared_ptr<Node>> nodes;
+        std::vector<std::pair<int, int>> edges;
+        std::vector<char> pinned;
+        std::unordered_set<const Node*> inSubtree;
+
+        // Edited subtree first ('changed' at index 0, anchored where it is)
+        std::vector<std::pair<std::shared_ptr<Node>, int>> pending{{changed, -1}};
+        while (!pending.empty()) {
+            auto [node, parentIndex] = pending.back();
+            pending.pop_back();
+
+            int index = static_cast<int>(nodes.size());
+            nodes.push_back(node);
+            inSubtree.insert(node.get());
+            pinned.push_back(node == changed || node->manualPosition);
+            if (parentIndex >= 0) edges.push_back({parentIndex, index});
+            if (nodes.size() > maxNodes) return result;
+            for (auto& child : node->children) pending.push_back({child, index});
+        }
+        const size_t subtreeSize = nodes.size();
+
+        // Keep what the radial pass overwrites, in case the result gets rejected
+        struct SavedPlacement { double x, y, angle, sectorStart, sectorEnd; };
+        std::vector<SavedPlacement> saved;
+        saved.reserve(subtreeSize);
+        for (const auto& node : nodes) {
+            saved.push_back({node->x, node->y, node->angle, node->sectorStart, node->sectorEnd});
+        }
+        auto restore = [&]() {
+            for (size_t i = 0; i < subtreeSize; i++) {
+                nodes[i]->x = saved[i].x;
+                nodes[i]->y = saved[i].y;
+                nodes[i]->angle = saved[i].angle;
+                nodes[i]->sectorStart = saved[i].sectorStart;
+                nodes[i]->sectorEnd = saved[i].sectorEnd;
+            }
+        };
+
+        int depth = 0;
+        for (auto p = changed->parent.lock(); p; p = p->parent.lock()) depth++;
+        calculateImprovedRadialLayout(changed, 0, 0, changed->sectorStart, changed->sectorEnd, depth);
+
+        // Nodes outside the subtree whose rectangle comes within 'margin' of the
+        // subtree's, looked up in the map's spatial index. Entries of the subtree itself
+        // still hold its old place until the caller updates them; they are skipped.
+        auto outsideNear = [&](double margin) {
+            double minX = std::numeric_limits<double>::max(), minY = minX;
+            double maxX = std::numeric_limits<double>::lowest(), maxY = maxX;
+            for (size_t i = 0; i < subtreeSize; i++) {
+                const Node& n = *nodes[i];
+                minX = std::min(minX, n.x - n.width / 2.0); maxX = std::max(maxX, n.x + n.width / 2.0);
+                minY = std::min(minY, n.y - n.height / 2.0); maxY = std::max(maxY, n.y + n.height / 2.0);
+            }
+            auto found = map.nodesInRect(minX - margin, minY - margin, maxX + margin, maxY + margin);
+            found.erase(std::remove_if(found.begin(), found.end(),
+                                       [&](const std::shared_ptr<Node>& node) { return inSubtree.count(node.get()) > 0; }),
+                        found.end());
+            return found;
+        };
+
+        // Neighbours take part as fixed obstacles so the subtree is pushed away from them
+        for (auto& node : outsideNear(E4Maps::INCREMENTAL_LAYOUT_MARGIN)) {
+            nodes.push_back(std::move(node));
+            pinned.push_back(1);
+        }
+        if (nodes.size() > maxNodes) {
+            restore();
+            return result;
+        }
+        result.movedNodes = subtreeSize;
+        result.pinnedNodes = nodes.size() - subtreeSize;
+
+        // Snapshot indices would refer to this partial node list, not to the tree
+        ForceLayoutOptions localOptions = options;
+        localOptions.onSnapshot = nullptr;
+        result.force = runForceSimulation(nodes, edges, pinned, localOptions);
+        if (result.force.cancelled) {
+            restore();
+            return result;
+        }
+
+        // The force pass sees points, not boxes: clear the overlaps between the subtree
+        // and whatever now surrounds it, with the surroundings held in place
+        std::vector<std::shared_ptr<Node>> local(nodes.begin(), nodes.begin() + subtreeSize);
+        std::vector<char> fixed(pinned.begin(), pinned.begin() + subtreeSize);
+        for (auto& node : outsideNear(E4Maps::OVERLAP_REMOVAL_GAP)) {
+            local.push_back(std::move(node));
+            fixed.push_back(1);
+        }
+        std::vector<double> x, y;
+        size_t constraints = 0;
+        separateNodes(local, fixed, x, y, constraints);
+        for (size_t i = 0; i < subtreeSize; i++) {
+            nodes[i]->x = x[i];
+            nodes[i]->y = y[i];
+        }
+
+        // Count what is left against whatever surrounds the subtree now (separation may
+        // have pushed it past the nodes collected above). Overlaps among the neighbours
+        // alone were there before the edit and do not count.
+        auto overlapsIn = [](const std::vector<std::shared_ptr<Node>>& a, const std::vector<std::shared_ptr<Node>>& b) {
+            std::vector<double> cx, cy, halfW, halfH;
+            for (const auto* list : {&a, &b}) {
+                for (const auto& node : *list) {
+                    cx.push_back(node->x);
+                    cy.push_back(node->y);
+                    halfW.push_back(node->width / 2.0);
+                    halfH.push_back(node->height / 2.0);
                 }
-                if (!ln2.fixed) {
-                    ln2.fx -= fx;
-                    ln2.fy -= fy;
+            }
+            return countOverlaps(cx, cy, halfW, halfH);
+        };
+        nodes.resize(subtreeSize);
+        auto around = outsideNear(0.0);
+        result.overlaps = overlapsIn(nodes, around) - overlapsIn({}, around);
+
+        result.nodes = std::move(nodes);
+        result.applied = true;
+        return result;
+    }
+
+    namespace {
+
+        // Walker's tidy tree in the linear-time form of Buchheim, Juenger and Leipert
+        // ("Improving Walker's Algorithm to Run in Linear Time"), with nodes of different
+        // sizes. Works on abstract coordinates: 'breadth' runs across siblings, depth
+        // counts levels; the caller maps both onto the screen.
+        // Nodes are kept in pre-order, so walking the arrays backwards visits every
+        // subtree before its root and no recursion is needed.
+        class TidyTree {
+        public:
+            std::vector<std::shared_ptr<Node>> nodes;
+            std::vector<int> parent, depth;
+            std::vector<double> size;    // Extent along the breadth axis
+            std::vector<double> breadth; // Result of layout()
+
+            void collect(const std::shared_ptr<Node>& root) {
+                std::vector<std::pair<std::shared_ptr<Node>, int>> pending{{root, -1}};
+                while (!pending.empty()) {
+                    auto [node, parentIndex] = pending.back();
+                    pending.pop_back();
+                    int index = static_cast<int>(nodes.size());
+                    nodes.push_back(node);
+                    parent.push_back(parentIndex);
+                    depth.push_back(parentIndex < 0 ? 0 : depth[parentIndex] + 1);
+                    for (auto it = node->children.rbegin(); it != node->children.rend(); ++it) {
+                        pending.push_back({*it, index});
+                    }
+                }
+
+                // Children of every node, left to right (pre-order keeps sibling order)
+                const size_t count = nodes.size();
+                childStart.assign(count + 1, 0);
+                for (size_t i = 1; i < count; i++) childStart[parent[i] + 1]++;
+                for (size_t i = 0; i < count; i++) childStart[i + 1] += childStart[i];
+                children.resize(count > 0 ? count - 1 : 0);
+                number.assign(count, 0);
+                std::vector<int> fill(childStart.begin(), childStart.end() - 1);
+                for (size_t i = 1; i < count; i++) {
+                    int p = parent[i];
+                    number[i] = fill[p] - childStart[p];
+                    children[fill[p]++] = static_cast<int>(i);
                 }
             }
 
-            // Update positions
-            for (auto& ln : layoutNodes) {
-                if (ln.fixed) continue; // Don't move manually positioned nodes
-                
-                double displacement = std::sqrt(ln.fx * ln.fx + ln.fy * ln.fy);
-                if (displacement > 0) {
-                    double factor = std::min(maxDisplacement, displacement) / displacement;
-                    ln.x += ln.fx * factor;
-                    ln.y += ln.fy * factor;
+            void layout(double siblingGap, double subtreeGap) {
+                const size_t count = nodes.size();
+                this->siblingGap = siblingGap;
+                this->subtreeGap = subtreeGap;
+                prelim.assign(count, 0.0);
+                mod.assign(count, 0.0);
+                shift.assign(count, 0.0);
+                change.assign(count, 0.0);
+                thread.assign(count, -1);
+                ancestor.resize(count);
+                for (size_t i = 0; i < count; i++) ancestor[i] = static_cast<int>(i);
+
+                // First walk: on arrival every child subtree is laid out around its own
+                // root (prelim = midpoint of its children, 0 for a leaf); place the children
+                // next to each other, push subtrees apart where their contours clash, then
+                // centre the parent over them.
+                for (size_t v = count; v-- > 0;) {
+                    if (isLeaf(v)) continue;
+                    int defaultAncestor = firstChild(v);
+                    for (int c = childStart[v]; c < childStart[v + 1]; c++) {
+                        int w = children[c];
+                        if (number[w] > 0) {
+                            int left = children[c - 1];
+                            double midpoint = prelim[w];
+                            prelim[w] = prelim[left] + distance(left, w);
+                            if (!isLeaf(w)) mod[w] = prelim[w] - midpoint;
+                        }
+                        defaultAncestor = apportion(w, defaultAncestor);
+                    }
+                    executeShifts(v);
+                    prelim[v] = (prelim[firstChild(v)] + prelim[lastChild(v)]) / 2.0;
+                }
+
+                // Second walk: a node's final position adds the modifiers of all its ancestors
+                std::vector<double> modSum(count, 0.0);
+                breadth.assign(count, 0.0);
+                for (size_t v = 0; v < count; v++) {
+                    if (parent[v] >= 0) modSum[v] = modSum[parent[v]] + mod[parent[v]];
+                    breadth[v] = prelim[v] + modSum[v];
+                }
+            }
+
+        private:
+            std::vector<int> childStart, children, number; // number = index among siblings
+            std::vector<double> prelim, mod, shift, change;
+            std::vector<int> thread, ancestor;
+            double siblingGap = 0.0, subtreeGap = 0.0;
+
+            bool isLeaf(size_t v) const { return childStart[v] == childStart[v + 1]; }
+            int firstChild(size_t v) const { return children[childStart[v]]; }
+            int lastChild(size_t v) const { return children[childStart[v + 1] - 1]; }
+
+            // Next node on the left / right contour one level down (-1 = contour ends)
+            int nextLeft(int v) const { return isLeaf(v) ? thread[v] : firstChild(v); }
+            int nextRight(int v) const { return isLeaf(v) ? thread[v] : lastChild(v); }
+
+            // Minimum centre distance between two neighbours on the same level
+            double distance(int left, int right) const {
+                double gap = parent[left] == parent[right] ? siblingGap : subtreeGap;
+                return (size[left] + size[right]) / 2.0 + gap;
+            }
+
+            // Moves subtree v clear of every subtree to its left. The contours are followed
+            // with threads, so the cost is bounded by the height of the smaller side.
+            int apportion(int v, int defaultAncestor) {
+                if (number[v] == 0) return defaultAncestor;
+
+                int insideRight = v, outsideRight = v;
+                int insideLeft = children[childStart[parent[v]] + number[v] - 1];
+                int outsideLeft = firstChild(parent[v]);
+                double sumInsideRight = mod[insideRight], sumOutsideRight = mod[outsideRight];
+                double sumInsideLeft = mod[insideLeft], sumOutsideLeft = mod[outsideLeft];
+
+                while (nextRight(insideLeft) >= 0 && nextLeft(insideRight) >= 0) {
+                    insideLeft = nextRight(insideLeft);
+                    insideRight = nextLeft(insideRight);
+                    outsideLeft = nextLeft(outsideLeft);
+                    outsideRight = nextRight(outsideRight);
+                    ancestor[outsideRight] = v;
+
+                    double overlap = (prelim[insideLeft] + sumInsideLeft)
+                                   - (prelim[insideRight] + sumInsideRight)
+                                   + distance(insideLeft, insideRight);
+                    if (overlap > 0.0) {
+                        int a = ancestor[insideLeft];
+                        moveSubtree(parent[a] == parent[v] ? a : defaultAncestor, v, overlap);
+                        sumInsideRight += overlap;
+                        sumOutsideRight += overlap;
+                    }
+                    sumInsideLeft += mod[insideLeft];
+                    sumInsideRight += mod[insideRight];
+                    sumOutsideLeft += mod[outsideLeft];
+                    sumOutsideRight += mod[outsideRight];
+                }
+
+                // The deeper side continues the shallower side's contour through a thread
+                if (nextRight(insideLeft) >= 0 && nextRight(outsideRight) < 0) {
+                    thread[outsideRight] = nextRight(insideLeft);
+                    mod[outsideRight] += sumInsideLeft - sumOutsideRight;
+                }
+                if (nextLeft(insideRight) >= 0 && nextLeft(outsideLeft) < 0) {
+                    thread[outsideLeft] = nextLeft(insideRight);
+                    mod[outsideLeft] += sumInsideRight - sumOutsideLeft;
+                    defaultAncestor = v;
+                }
+                return defaultAncestor;
+            }
+
+            // Shifts subtree 'right' by 'amount' and records that the siblings between it
+            // and 'left' should be spread out evenly; executeShifts applies that later.
+            void moveSubtree(int left, int right, double amount) {
+                double subtrees = number[right] - number[left];
+                change[right] -= amount / subtrees;
+                shift[right] += amount;
+                change[left] += amount / subtrees;
+                prelim[right] += amount;
+                mod[right] += amount;
+            }
+
+            void executeShifts(size_t v) {
+                double totalShift = 0.0, totalChange = 0.0;
+                for (int c = childStart[v + 1]; c-- > childStart[v];) {
+                    int w = children[c];
+                    prelim[w] += totalShift;
+                    mod[w] += totalShift;
+                    totalChange += change[w];
+                    totalShift += shift[w] + totalChange;
+                }
+            }
+        };
+
+    } // namespace
+
+    void calculateTidyTreeLayout(std::shared_ptr<Node> root, TidyTreeOrientation orientation) {
+        if (!root) return;
+
+        TidyTree tree;
+        tree.collect(root);
+        const size_t count = tree.nodes.size();
+
+        // Footprint of every node along the breadth and depth axes. Radial rotates nodes
+        // to arbitrary angles, so there a node counts as its bounding circle.
+        std::vector<double> depthSize(count);
+        tree.size.resize(count);
+        for (size_t i = 0; i < count; i++) {
+            const Node& node = *tree.nodes[i];
+            switch (orientation) {
+                case TidyTreeOrientation::Horizontal:
+                    tree.size[i] = node.height;
+                    depthSize[i] = node.width;
+                    break;
+                case TidyTreeOrientation::Vertical:
+                    tree.size[i] = node.width;
+                    depthSize[i] = node.height;
+                    break;
+                case TidyTreeOrientation::Radial:
+                    tree.size[i] = depthSize[i] = std::hypot(node.width, node.height);
+                    break;
+            }
+        }
+
+        tree.layout(E4Maps::TIDY_TREE_SIBLING_GAP, E4Maps::TIDY_TREE_SUBTREE_GAP);
+
+        // Distance of every depth from the root: the widest node of a level decides how
+        // far the next one starts
+        int maxDepth = 0;
+        for (size_t i = 0; i < count; i++) maxDepth = std::max(maxDepth, tree.depth[i]);
+        std::vector<double> levelSize(maxDepth + 1, 0.0);
+        for (size_t i = 0; i < count; i++) {
+            levelSize[tree.depth[i]] = std::max(levelSize[tree.depth[i]], depthSize[i]);
+        }
+        std::vector<double> levelOffset(maxDepth + 1, 0.0);
+        for (int d = 1; d <= maxDepth; d++) {
+            levelOffset[d] = levelOffset[d - 1] + (levelSize[d - 1] + levelSize[d]) / 2.0
+                           + E4Maps::TIDY_TREE_LEVEL_GAP;
+        }
+
+        const double originX = root->x, originY = root->y;
+        const double rootBreadth = tree.breadth[0];
+
+        if (orientation != TidyTreeOrientation::Radial) {
+            for (size_t i = 1; i < count; i++) {
+                Node& node = *tree.nodes[i];
+                if (node.manualPosition) continue;
+                double across = tree.breadth[i] - rootBreadth;
+                if (orientation == TidyTreeOrientation::Horizontal) {
+                    node.x = originX + levelOffset[tree.depth[i]];
+                    node.y = originY + across;
+                } else {
+                    node.x = originX + across;
+                    node.y = originY + levelOffset[tree.depth[i]];
+                }
+            }
+            return;
+        }
+
+        // Radial: the breadth axis, plus one subtree gap to keep the first and last
+        // nodes apart, is wrapped around the full circle
+        if (count == 1) return;
+        double low = tree.breadth[1] - tree.size[1] / 2.0;
+        double high = tree.breadth[1] + tree.size[1] / 2.0;
+        for (size_t i = 2; i < count; i++) {
+            low = std::min(low, tree.breadth[i] - tree.size[i] / 2.0);
+            high = std::max(high, tree.breadth[i] + tree.size[i] / 2.0);
+        }
+        const double span = high - low + E4Maps::TIDY_TREE_SUBTREE_GAP;
+        const double startAngle = -M_PI / 2.0; // First child straight above the root
+        auto angleOf = [&](double b) { return startAngle + 2.0 * M_PI * (b - low) / span; };
+
+        // Each ring lies at least one level gap outside the previous one, and far enough
+        // out that the chord between neighbours on it covers their separation.
+        // Pre-order meets the nodes of a level in breadth order.
+        std::vector<std::vector<int>> rings(maxDepth + 1);
+        for (size_t i = 1; i < count; i++) rings[tree.depth[i]].push_back(static_cast<int>(i));
+
+        std::vector<double> radius(maxDepth + 1, 0.0);
+        for (int d = 1; d <= maxDepth; d++) {
+            double r = radius[d - 1] + (levelSize[d - 1] + levelSize[d]) / 2.0 + E4Maps::TIDY_TREE_LEVEL_GAP;
+            const std::vector<int>& ring = rings[d];
+            for (size_t k = 0; ring.size() > 1 && k < ring.size(); k++) {
+                int a = ring[k];
+                int b = ring[(k + 1) % ring.size()];
+                double gap = angleOf(tree.breadth[b]) - angleOf(tree.breadth[a]);
+                if (gap <= 0.0) gap += 2.0 * M_PI; // Wrapping from the last node to the first
+                double needed = (tree.size[a] + tree.size[b]) / 2.0 + E4Maps::TIDY_TREE_SIBLING_GAP;
+                r = std::max(r, needed / (2.0 * std::sin(std::max(gap, 1e-6) / 2.0)));
+            }
+            radius[d] = r;
+        }
+
+        // Angular extent of every subtree, gathered bottom-up
+        std::vector<double> sectorLow(count), sectorHigh(count);
+        for (size_t i = 0; i < count; i++) {
+            sectorLow[i] = tree.breadth[i] - tree.size[i] / 2.0;
+            sectorHigh[i] = tree.breadth[i] + tree.size[i] / 2.0;
+        }
+        for (size_t i = count; i-- > 1;) {
+            int p = tree.parent[i];
+            sectorLow[p] = std::min(sectorLow[p], sectorLow[i]);
+            sectorHigh[p] = std::max(sectorHigh[p], sectorHigh[i]);
+        }
+
+        root->sectorStart = startAngle;
+        root->sectorEnd = startAngle + 2.0 * M_PI;
+        for (size_t i = 1; i < count; i++) {
+            Node& node = *tree.nodes[i];
+            node.angle = angleOf(tree.breadth[i]);
+            node.sectorStart = angleOf(sectorLow[i]);
+            node.sectorEnd = angleOf(sectorHigh[i]);
+            if (node.manualPosition) continue;
+            double r = radius[tree.depth[i]];
+            node.x = originX + r * std::cos(node.angle);
+            node.y = originY + r * std::sin(node.angle);
+        }
+    }
+
+    namespace {
+
+        // Unfiltered x + y rounds overlap removal may add when fixed nodes got in the way
+        constexpr int OVERLAP_REMOVAL_EXTRA_ROUNDS = 2;
+
+        // pos[right] - pos[left] >= separation
+        struct SeparationConstraint {
+            int left, right;
+            double separation;
+        };
+
+        // Constraints that keep apart, along 'pos', boxes whose extents overlap along 'cross'.
+        // A sweep over 'cross' keeps the open boxes sorted by (pos, index); every pair that
+        // becomes adjacent in that order gets a constraint. Any two boxes that are open at
+        // the same time are then linked by a chain of constraints, with at most three
+        // constraints per box.
+        // cheapestOnly leaves out overlapping pairs that need less movement along 'cross',
+        // so the pass over the other axis can deal with them instead.
+        void generateSeparationConstraints(const std::vector<double>& pos, const std::vector<double>& halfPos,
+                                           const std::vector<double>& cross, const std::vector<double>& halfCross,
+                                           const std::vector<char>& fixed, bool cheapestOnly,
+                                           std::vector<SeparationConstraint>& constraints) {
+            struct Event {
+                double at;
+                bool open;
+                int box;
+            };
+            const size_t count = pos.size();
+            std::vector<Event> events;
+            events.reserve(count * 2);
+            for (size_t i = 0; i < count; i++) {
+                events.push_back({cross[i] - halfCross[i], true, static_cast<int>(i)});
+                events.push_back({cross[i] + halfCross[i], false, static_cast<int>(i)});
+            }
+            // Boxes that merely touch never meet: closes go first
+            std::sort(events.begin(), events.end(), [](const Event& a, const Event& b) {
+                if (a.at != b.at) return a.at < b.at;
+                if (a.open != b.open) return !a.open;
+                return a.box < b.box;
+            });
+
+            auto add = [&](int a, int b) {
+                if (fixed[a] && fixed[b]) return; // Nothing either pass could do about it
+                if (cheapestOnly) {
+                    double overlapPos = halfPos[a] + halfPos[b] - std::abs(pos[a] - pos[b]);
+                    double overlapCross = halfCross[a] + halfCross[b] - std::abs(cross[a] - cross[b]);
+                    if (overlapPos > 0.0 && overlapPos > overlapCross) return;
+                }
+                constraints.push_back({a, b, halfPos[a] + halfPos[b]});
+            };
+
+            std::set<std::pair<double, int>> open;
+            for (const Event& event : events) {
+                auto key = std::make_pair(pos[event.box], event.box);
+                if (event.open) {
+                    auto it = open.insert(key).first;
+                    if (it != open.begin()) add(std::prev(it)->second, event.box);
+                    if (std::next(it) != open.end()) add(event.box, std::next(it)->second);
+                } else {
+                    auto it = open.find(key);
+                    if (it != open.begin() && std::next(it) != open.end()) {
+                        add(std::prev(it)->second, std::next(it)->second);
+                    }
+                    open.erase(it);
+                }
+            }
+        }
+
+        // Moves the free entries of 'pos' so that every constraint holds. Sweeping in
+        // constraint order gives the rightmost-pushed and, backwards, the leftmost-pushed
+        // feasible placement; both are feasible, so their midpoint is too, and it splits
+        // every push evenly between the two sides instead of drifting one way. Not the
+        // least-squares optimum, but linear in the number of constraints.
+        // Fixed entries bound the free ones; where they leave too little room some
+        // constraints stay violated.
+        void satisfySeparation(std::vector<double>& pos, const std::vector<char>& fixed,
+                               const std::vector<SeparationConstraint>& constraints) {
+            const size_t count = pos.size();
+            std::vector<int> order(count);
+            for (size_t i = 0; i < count; i++) order[i] = static_cast<int>(i);
+            // Constraints always point forward in this order (they were generated from it)
+            std::sort(order.begin(), order.end(), [&](int a, int b) {
+                return pos[a] != pos[b] ? pos[a] < pos[b] : a < b;
+            });
+
+            std::vector<int> inStart(count + 1, 0), outStart(count + 1, 0);
+            for (const auto& c : constraints) {
+                inStart[c.right + 1]++;
+                outStart[c.left + 1]++;
+            }
+            for (size_t i = 0; i < count; i++) {
+                inStart[i + 1] += inStart[i];
+                outStart[i + 1] += outStart[i];
+            }
+            std::vector<int> incoming(constraints.size()), outgoing(constraints.size());
+            {
+                std::vector<int> inFill(inStart.begin(), inStart.end() - 1);
+                std::vector<int> outFill(outStart.begin(), outStart.end() - 1);
+                for (size_t k = 0; k < constraints.size(); k++) {
+                    incoming[inFill[constraints[k].right]++] = static_cast<int>(k);
+                    outgoing[outFill[constraints[k].left]++] = static_cast<int>(k);
+                }
+            }
+
+            // Room the fixed entries leave to every free one
+            const double infinity = std::numeric_limits<double>::infinity();
+            std::vector<double> lowest(count, -infinity), highest(count, infinity);
+            for (int v : order) {
+                if (fixed[v]) { lowest[v] = pos[v]; continue; }
+                for (int k = inStart[v]; k < inStart[v + 1]; k++) {
+                    const auto& c = constraints[incoming[k]];
+                    lowest[v] = std::max(lowest[v], lowest[c.left] + c.separation);
+                }
+            }
+            for (auto it = order.rbegin(); it != order.rend(); ++it) {
+                int v = *it;
+                if (fixed[v]) { highest[v] = pos[v]; continue; }
+                for (int k = outStart[v]; k < outStart[v + 1]; k++) {
+                    const auto& c = constraints[outgoing[k]];
+                    highest[v] = std::min(highest[v], highest[c.right] - c.separation);
+                }
+            }
+
+            std::vector<double> pushedRight(count), pushedLeft(count);
+            for (int v : order) {
+                double p = pos[v];
+                if (!fixed[v]) {
+                    for (int k = inStart[v]; k < inStart[v + 1]; k++) {
+                        const auto& c = constraints[incoming[k]];
+                        p = std::max(p, pushedRight[c.left] + c.separation);
+                    }
+                    p = std::min(p, highest[v]);
+                }
+                pushedRight[v] = p;
+            }
+            for (auto it = order.rbegin(); it != order.rend(); ++it) {
+                int v = *it;
+                double p = pos[v];
+                if (!fixed[v]) {
+                    for (int k = outStart[v]; k < outStart[v + 1]; k++) {
+                        const auto& c = constraints[outgoing[k]];
+                        p = std::min(p, pushedLeft[c.right] - c.separation);
+                    }
+                    p = std::max(p, lowest[v]);
                 }
+                pushedLeft[v] = p;
+            }
+
+            for (size_t i = 0; i < count; i++) {
+                if (!fixed[i]) pos[i] = (pushedLeft[i] + pushedRight[i]) / 2.0;
             }
         }
 
-        // Update original nodes with new positions
-        for (size_t i = 0; i < layoutNodes.size(); i++) {
-            layoutNodes[i].node->x = layoutNodes[i].x;
-            layoutNodes[i].node->y = layoutNodes[i].y;
+        // Pairs of boxes that overlap, by sweeping over x with the open boxes sorted by y
+        size_t countOverlaps(const std::vector<double>& x, const std::vector<double>& y,
+                             const std::vector<double>& halfW, const std::vector<double>& halfH) {
+            const size_t count = x.size();
+            std::vector<std::pair<double, int>> events; // (x, box + 1) opens, (x, -(box + 1)) closes
+            events.reserve(count * 2);
+            double maxHalfH = 0.0;
+            for (size_t i = 0; i < count; i++) {
+                int id = static_cast<int>(i) + 1;
+                events.push_back({x[i] - halfW[i], id});
+                events.push_back({x[i] + halfW[i], -id});
+                maxHalfH = std::max(maxHalfH, halfH[i]);
+            }
+            std::sort(events.begin(), events.end()); // Closes sort before opens at the same x
+
+            size_t overlaps = 0;
+            std::set<std::pair<double, int>> open;
+            for (const auto& [at, id] : events) {
+                int box = std::abs(id) - 1;
+                if (id < 0) {
+                    open.erase({y[box], box});
+                    continue;
+                }
+                // Only boxes less than the tallest possible reach away in y can touch this one
+                auto it = open.lower_bound({y[box] - halfH[box] - maxHalfH, -1});
+                for (; it != open.end() && it->first < y[box] + halfH[box] + maxHalfH; ++it) {
+                    if (std::abs(it->first - y[box]) < halfH[box] + halfH[it->second]) overlaps++;
+                }
+                open.insert({y[box], box});
+            }
+            return overlaps;
+        }
+
+        // The separation passes of removeOverlaps over any set of nodes, with the caller
+        // choosing which of them stay put. Fills x and y with the new centres and returns
+        // the pairs still overlapping.
+        size_t separateNodes(const std::vector<std::shared_ptr<Node>>& nodes, const std::vector<char>& fixed,
+                             std::vector<double>& x, std::vector<double>& y, size_t& constraintCount) {
+            const size_t count = nodes.size();
+
+            // Boxes grow by half the gap on every side, so boxes that do not overlap are a gap apart
+            const double margin = E4Maps::OVERLAP_REMOVAL_GAP / 2.0;
+            x.assign(count, 0.0);
+            y.assign(count, 0.0);
+            std::vector<double> halfW(count), halfH(count);
+            for (size_t i = 0; i < count; i++) {
+                const Node& node = *nodes[i];
+                x[i] = node.x;
+                y[i] = node.y;
+                halfW[i] = node.width / 2.0 + margin;
+                halfH[i] = node.height / 2.0 + margin;
+            }
+
+            std::vector<SeparationConstraint> constraints;
+            generateSeparationConstraints(x, halfW, y, halfH, fixed, true, constraints);
+            satisfySeparation(x, fixed, constraints);
+            constraintCount += constraints.size();
+
+            // Every pair still overlapping sideways gets a constraint here, so this pass
+            // leaves no overlap behind unless fixed nodes are in the way
+            constraints.clear();
+            generateSeparationConstraints(y, halfH, x, halfW, fixed, false, constraints);
+            satisfySeparation(y, fixed, constraints);
+            constraintCount += constraints.size();
+
+            // Fixed nodes can block the vertical pass; give the stragglers a few more rounds
+            // in which either axis may resolve them
+            std::vector<double> realHalfW(count), realHalfH(count);
+            for (size_t i = 0; i < count; i++) {
+                realHalfW[i] = nodes[i]->width / 2.0;
+                realHalfH[i] = nodes[i]->height / 2.0;
+            }
+            size_t remaining = countOverlaps(x, y, realHalfW, realHalfH);
+            for (int round = 0; round < OVERLAP_REMOVAL_EXTRA_ROUNDS && remaining > 0; round++) {
+                constraints.clear();
+                generateSeparationConstraints(x, halfW, y, halfH, fixed, false, constraints);
+                satisfySeparation(x, fixed, constraints);
+                constraintCount += constraints.size();
+
+                constraints.clear();
+                generateSeparationConstraints(y, halfH, x, halfW, fixed, false, constraints);
+                satisfySeparation(y, fixed, constraints);
+                constraintCount += constraints.size();
+
+                remaining = countOverlaps(x, y, realHalfW, realHalfH);
+            }
+            return remaining;
+        }
+
+    } // namespace
+
+    OverlapRemovalStats removeOverlaps(std::shared_ptr<Node> root,
+                                       const std::function<void(LayoutSnapshot&&)>& onSnapshot) {
+        OverlapRemovalStats stats;
+        if (!root) return stats;
+        auto startTime = std::chrono::steady_clock::now();
+
+        std::vector<std::shared_ptr<Node>> nodes = collectPreOrder(root);
+        const size_t count = nodes.size();
+        stats.nodeCount = count;
+
+        std::vector<char> fixed(count);
+        for (size_t i = 0; i < count; i++) fixed[i] = nodes[i]->manualPosition || nodes[i]->isRoot();
+        std::vector<double> x, y;
+        stats.remainingOverlaps = separateNodes(nodes, fixed, x, y, stats.constraints);
+
+        LayoutSnapshot snapshot;
+        snapshot.final = true;
+        for (size_t i = 0; i < count; i++) {
+            Node& node = *nodes[i];
+            if (x[i] == node.x && y[i] == node.y) continue;
+            node.x = x[i];
+            node.y = y[i];
+            snapshot.indices.push_back(static_cast<int>(i));
+            snapshot.x.push_back(x[i]);
+            snapshot.y.push_back(y[i]);
+        }
+        stats.movedNodes = snapshot.indices.size();
+        if (onSnapshot && stats.movedNodes > 0) onSnapshot(std::move(snapshot));
+
+        stats.totalMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+        return stats;
+    }
+
+    std::vector<std::shared_ptr<Node>> removeOverlaps(MindMap& map, const std::vector<std::shared_ptr<Node>>& nodes) {
+        std::vector<std::shared_ptr<Node>> moved;
+        std::unordered_set<const Node*> wasMoved;
+
+        // Pushing a node aside can land it on one that was not around before, so the
+        // nodes that moved look up their own neighbourhood in the next round
+        std::vector<std::shared_ptr<Node>> seeds = nodes;
+        for (int round = 0; round <= OVERLAP_REMOVAL_EXTRA_ROUNDS && !seeds.empty(); round++) {
+            std::vector<std::shared_ptr<Node>> local;
+            std::unordered_set<const Node*> seen;
+            for (const auto& node : seeds) {
+                if (seen.insert(node.get()).second) local.push_back(node);
+            }
+            // Neighbours closer than the gap take part, and move too if they have to
+            const double reach = E4Maps::OVERLAP_REMOVAL_GAP;
+            const size_t seedCount = local.size();
+            for (size_t i = 0; i < seedCount; i++) {
+                const Node& node = *local[i];
+                auto found = map.nodesInRect(node.x - node.width / 2.0 - reach, node.y - node.height / 2.0 - reach,
+                                             node.x + node.width / 2.0 + reach, node.y + node.height / 2.0 + reach);
+                for (auto& neighbour : found) {
+                    if (seen.insert(neighbour.get()).second) local.push_back(std::move(neighbour));
+                }
+            }
+
+            std::vector<char> fixed(local.size());
+            for (size_t i = 0; i < local.size(); i++) fixed[i] = local[i]->manualPosition || local[i]->isRoot();
+            std::vector<double> x, y;
+            size_t constraints = 0;
+            separateNodes(local, fixed, x, y, constraints);
+
+            seeds.clear();
+            for (size_t i = 0; i < local.size(); i++) {
+                Node& node = *local[i];
+                if (x[i] == node.x && y[i] == node.y) continue;
+                node.x = x[i];
+                node.y = y[i];
+                seeds.push_back(local[i]);
+                if (wasMoved.insert(&node).second) moved.push_back(local[i]);
+            }
+            // The index still has the old places of the moved nodes
+            for (const auto& node : seeds) map.updateNodeBounds(*node);
+        }
+        return moved;
+    }
+
+    namespace {
+
+        // Runs that finish sooner than this are dominated by fixed costs and say little
+        // about how an engine scales, so they do not feed the registry's estimates
+        constexpr double LAYOUT_MIN_RECORDED_MS = 5.0;
+        // Weight of the newest run in an engine's measured slowdown
+        constexpr double LAYOUT_SLOWDOWN_SMOOTHING = 0.3;
+
+        // Wraps a one-shot layout into the engine contract: nothing is written if the
+        // run gets cancelled meanwhile, and the result goes out as one final snapshot
+        ForceLayoutStats runOneShot(const std::shared_ptr<Node>& root, const ForceLayoutOptions& options,
+                                    const std::function<void()>& layout) {
+            ForceLayoutStats stats;
+            auto startTime = std::chrono::steady_clock::now();
+            auto cancelled = [&]() { return options.cancel && options.cancel->load(); };
+
+            std::vector<std::shared_ptr<Node>> nodes = collectPreOrder(root);
+            stats.nodeCount = nodes.size();
+            if (cancelled()) {
+                stats.cancelled = true;
+                return stats;
+            }
+
+            std::vector<double> oldX(nodes.size()), oldY(nodes.size());
+            for (size_t i = 0; i < nodes.size(); i++) {
+                oldX[i] = nodes[i]->x;
+                oldY[i] = nodes[i]->y;
+            }
+            layout();
+
+            if (cancelled()) {
+                for (size_t i = 0; i < nodes.size(); i++) {
+                    nodes[i]->x = oldX[i];
+                    nodes[i]->y = oldY[i];
+                }
+                stats.cancelled = true;
+            } else {
+                stats.converged = true;
+                if (options.onSnapshot) {
+                    LayoutSnapshot snapshot;
+                    snapshot.final = true;
+                    for (size_t i = 0; i < nodes.size(); i++) {
+                        if (nodes[i]->x == oldX[i] && nodes[i]->y == oldY[i]) continue;
+                        snapshot.indices.push_back(static_cast<int>(i));
+                        snapshot.x.push_back(nodes[i]->x);
+                        snapshot.y.push_back(nodes[i]->y);
+                    }
+                    options.onSnapshot(std::move(snapshot));
+                }
+            }
+
+            stats.totalMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+            return stats;
+        }
+
+        void seedRadial(const std::shared_ptr<Node>& root) {
+            calculateImprovedRadialLayout(root, root->x, root->y, 0, 2 * M_PI, 0);
+        }
+
+        // Reference costs below were measured on one core with mind-map shaped trees
+
+        class ForceDirectedEngine : public LayoutEngine {
+        public:
+            const char* id() const override { return "force"; }
+            const char* name() const override { return N_("Force-directed"); }
+            void seed(std::shared_ptr<Node> root) const override { seedRadial(root); }
+
+            ForceLayoutStats run(std::shared_ptr<Node> root, const ForceLayoutOptions& options) const override {
+                return calculateForceDirectedLayout(root, 4096, 4096, options);
+            }
+
+            double estimateMs(size_t nodeCount) const override {
+                // A few hundred iterations, all-pairs below the Barnes-Hut threshold
+                double n = static_cast<double>(nodeCount);
+                if (nodeCount <= static_cast<size_t>(E4Maps::BARNES_HUT_THRESHOLD)) return 2.2e-4 * n * n;
+                return 0.055 * n * std::log2(n);
+            }
+
+            bool supportsIncremental() const override { return true; }
+            bool automatic() const override { return true; }
+        };
+
+        class MultilevelEngine : public LayoutEngine {
+        public:
+            const char* id() const override { return "multilevel"; }
+            const char* name() const override { return N_("Multilevel force-directed"); }
+            void seed(std::shared_ptr<Node> root) const override { seedRadial(root); }
+
+            ForceLayoutStats run(std::shared_ptr<Node> root, const ForceLayoutOptions& options) const override {
+                return calculateMultilevelLayout(root, options);
+            }
+
+            double estimateMs(size_t nodeCount) const override {
+                double n = static_cast<double>(std::max<size_t>(nodeCount, 2));
+                return 0.013 * n * std::log2(n);
+            }
+
+            bool supportsIncremental() const override { return true; }
+            bool automatic() const override { return true; }
+        };
+
+        class TidyTreeEngine : public LayoutEngine {
+        public:
+            TidyTreeEngine(const char* id, const char* name, TidyTreeOrientation orientation, bool automatic)
+                : engineId(id), engineName(name), orientation(orientation), isAutomatic(automatic) {}
+
+            const char* id() const override { return engineId; }
+            const char* name() const override { return engineName; }
+
+            ForceLayoutStats run(std::shared_ptr<Node> root, const ForceLayoutOptions& options) const override {
+                return runOneShot(root, options, [&]() { calculateTidyTreeLayout(root, orientation); });
+            }
+
+            double estimateMs(size_t nodeCount) const override { return 3e-4 * static_cast<double>(nodeCount); }
+
+            bool automatic() const override { return isAutomatic; }
+
+        private:
+            const char* engineId;
+            const char* engineName;
+            TidyTreeOrientation orientation;
+            bool isAutomatic;
+        };
+
+        // The original even-angle radial layout, for users who prefer it
+        class RadialEngine : public LayoutEngine {
+        public:
+            const char* id() const override { return "radial"; }
+            const char* name() const override { return N_("Radial"); }
+
+            ForceLayoutStats run(std::shared_ptr<Node> root, const ForceLayoutOptions& options) const override {
+                return runOneShot(root, options, [&]() { seedRadial(root); });
+            }
+
+            double estimateMs(size_t nodeCount) const override { return 2e-4 * static_cast<double>(nodeCount); }
+
+            bool supportsIncremental() const override { return true; }
+        };
+
+    } // namespace
+
+    LayoutEngineRegistry::LayoutEngineRegistry() {
+        add(std::make_unique<ForceDirectedEngine>());
+        add(std::make_unique<MultilevelEngine>());
+        add(std::make_unique<TidyTreeEngine>("tidy-radial", N_("Tidy tree (radial)"), TidyTreeOrientation::Radial, true));
+        add(std::make_unique<TidyTreeEngine>("tidy-horizontal", N_("Tidy tree (horizontal)"), TidyTreeOrientation::Horizontal, false));
+        add(std::make_unique<TidyTreeEngine>("tidy-vertical", N_("Tidy tree (vertical)"), TidyTreeOrientation::Vertical, false));
+        add(std::make_unique<RadialEngine>());
+    }
+
+    void LayoutEngineRegistry::add(std::unique_ptr<LayoutEngine> engine) {
+        if (!engine) return;
+        registered.push_back(std::move(engine));
+        slowdown.push_back(1.0);
+    }
+
+    const LayoutEngine* LayoutEngineRegistry::find(const std::string& id) const {
+        for (const auto& engine : registered) {
+            if (id == engine->id()) return engine.get();
+        }
+        return nullptr;
+    }
+
+    const LayoutEngine* LayoutEngineRegistry::choose(size_t nodeCount, double budgetMs) const {
+        const LayoutEngine* fastest = nullptr;
+        double fastestMs = std::numeric_limits<double>::infinity();
+        for (const auto& engine : registered) {
+            if (!engine->automatic()) continue;
+            double expected = estimateMs(*engine, nodeCount);
+            if (expected <= budgetMs) return engine.get();
+            if (expected < fastestMs) {
+                fastestMs = expected;
+                fastest = engine.get();
+            }
+        }
+        return fastest;
+    }
+
+    double LayoutEngineRegistry::estimateMs(const LayoutEngine& engine, size_t nodeCount) const {
+        size_t index = indexOf(engine);
+        double factor = index < slowdown.size() ? slowdown[index] : 1.0;
+        return engine.estimateMs(nodeCount) * factor;
+    }
+
+    void LayoutEngineRegistry::recordRun(const LayoutEngine& engine, const ForceLayoutStats& stats) {
+        size_t index = indexOf(engine);
+        if (index >= slowdown.size() || stats.cancelled || stats.totalMs < LAYOUT_MIN_RECORDED_MS) return;
+        double expected = engine.estimateMs(stats.nodeCount);
+        if (expected <= 0.0) return;
+
+        double measured = std::clamp(stats.totalMs / expected, 0.1, 10.0); // One odd run must not flip the choice
+        slowdown[index] += (measured - slowdown[index]) * LAYOUT_SLOWDOWN_SMOOTHING;
+    }
+
+    size_t LayoutEngineRegistry::indexOf(const LayoutEngine& engine) const {
+        for (size_t i = 0; i < registered.size(); i++) {
+            if (registered[i].get() == &engine) return i;
         }
+        return registered.size();
     }
 
-} // namespace LayoutAlgorithms
\ No newline at end of file
+} // namespace LayoutAlgorithms
@@ -3,16 +3,232 @@
 
 #include "MindMap.hpp"
 #include <vector>
+#include <cstddef>
+#include <atomic>
+#include <functional>
+#include <string>
+#include <memory>
 
 namespace LayoutAlgorithms {
 
+    // Repulsion kernels available to the force-directed layout
+    enum class RepulsionMethod {
+        Auto,       // Exact below E4Maps::BARNES_HUT_THRESHOLD nodes, Barnes-Hut above
+        Exact,      // All-pairs loop, O(n^2) per iteration
+        BarnesHut   // Quadtree approximation, O(n log n) per iteration
+    };
+
+    // Positions published while a force-directed run is still going.
+    // Only nodes that moved since the previous snapshot are listed, in increasing index
+    // order; an index is the node's pre-order position in the tree given to the layout.
+    struct LayoutSnapshot {
+        std::vector<int> indices;
+        std::vector<double> x, y;
+        int iteration = 0;
+        bool final = false; // Last snapshot of a run that ran to the end
+    };
+
+    // Shapes the tidy-tree layout can take
+    enum class TidyTreeOrientation {
+        Horizontal, // Root on the left, one column per depth
+        Vertical,   // Root on top, one row per depth
+        Radial      // Depths become rings around the root
+    };
+
+    // Tuning knobs for the force-directed layout
+    struct ForceLayoutOptions {
+        RepulsionMethod repulsion = RepulsionMethod::Auto;
+
+        // Barnes-Hut opening criterion: a quadtree cell of side s seen from distance d
+        // is replaced by its centre of mass when s / d < theta.
+        // 0 degenerates to the exact kernel; higher values are faster but coarser.
+        double theta = 0.8;
+
+        // Threads for force accumulation and position updates (0 = one per core). They
+        // come from a pool shared by every run, which has one thread per core.
+        // The result does not depend on this value.
+        unsigned threads = 0;
+
+        // Iterations stop as soon as the layout has settled, or after maxIterations
+        int maxIterations = 300;
+
+        // Settled = no node moved more than this many pixels in the last iteration...
+        double displacementTolerance = 1.0;
+
+        // ...or the system energy (sum of squared net forces) changed by less than
+        // this fraction since the previous iteration.
+        double energyTolerance = 1e-4;
+
+        // Adaptive cooling: the step length starts at initialStep and is multiplied by
+        // coolingFactor whenever the energy goes up, and divided by it (up to
+        // initialStep) after five consecutive iterations of decreasing energy.
+        double initialStep = 50.0;
+        double coolingFactor = 0.9;
+
+        // Polled once per iteration; when it reads true the run stops and leaves the
+        // nodes where they were (stats.cancelled is set). Must outlive the call.
+        const std::atomic<bool>* cancel = nullptr;
+
+        // Progressive output. onSnapshot is called on the layout thread every
+        // snapshotEveryIterations iterations and/or every snapshotEveryMs milliseconds
+        // (0 disables either trigger), and once more with final = true when the run ends.
+        std::function<void(LayoutSnapshot&&)> onSnapshot;
+        int snapshotEveryIterations = 0;
+        double snapshotEveryMs = 0.0;
+    };
+
+    // What a force-directed run actually did, for tuning the options above
+    struct ForceLayoutStats {
+        int iterations = 0;           // Iterations performed
+        bool converged = false;       // false = stopped at maxIterations
+        bool cancelled = false;       // Stopped through options.cancel, nothing written back
+        double finalEnergy = 0.0;     // Sum of squared net forces in the last iteration
+        double finalStep = 0.0;       // Step length when the run stopped
+        double maxDisplacement = 0.0; // Largest single move in the last iteration
+        double totalMs = 0.0;         // Wall time of the whole run
+        double msPerIteration = 0.0;
+        size_t nodeCount = 0;
+        bool usedBarnesHut = false;
+        int levels = 1;               // Hierarchy depth (multilevel engine only)
+    };
+
+    // Outcome of a local re-layout
+    struct IncrementalLayoutResult {
+        bool applied = false;    // false = the edit was not local enough, nothing was moved
+        size_t movedNodes = 0;   // Nodes of the edited subtree that were laid out again
+        size_t pinnedNodes = 0;  // Neighbours that took part as fixed obstacles
+        size_t overlaps = 0;     // Overlapping node pairs left around the subtree
+        ForceLayoutStats force;
+        std::vector<std::shared_ptr<Node>> nodes; // The edited subtree, i.e. every node that may have moved
+    };
+
+    // What an overlap removal pass did
+    struct OverlapRemovalStats {
+        size_t nodeCount = 0;
+        size_t constraints = 0;       // Separation constraints generated over both axes
+        size_t movedNodes = 0;
+        size_t remainingOverlaps = 0; // Only when manually placed nodes leave no room
+        double totalMs = 0.0;
+    };
+
     // Improved radial layout that spreads nodes more evenly
     void calculateImprovedRadialLayout(std::shared_ptr<Node> node, double cx, double cy,
                                        double startAngle, double endAngle, int depth);
 
+    // Tidy tree (Walker's algorithm in Buchheim's linear-time form) around the root's
+    // current position. Siblings are packed using their measured width/height plus
+    // E4Maps::TIDY_TREE_SIBLING_GAP / TIDY_TREE_SUBTREE_GAP, and depths are
+    // E4Maps::TIDY_TREE_LEVEL_GAP apart, so nodes do not overlap and no force pass is
+    // needed afterwards. Radial bends the breadth axis around a circle and picks each
+    // ring's radius so that neighbours on it stay apart; it also records sectors like
+    // calculateImprovedRadialLayout does. Nodes with manualPosition keep their place.
+    void calculateTidyTreeLayout(std::shared_ptr<Node> root, TidyTreeOrientation orientation);
+
     // Force-directed layout algorithm for better readability
-    void calculateForceDirectedLayout(std::shared_ptr<Node> root, int width, int height);
+    ForceLayoutStats calculateForceDirectedLayout(std::shared_ptr<Node> root, int width, int height,
+                                      const ForceLayoutOptions& options = ForceLayoutOptions());
+
+    // Multilevel variant for very large maps.
+    // The tree is coarsened into weighted super-nodes (leaves fold into their parent,
+    // chains pair up) until a few dozen remain; that graph is laid out, then each level
+    // is prolonged to the next finer one and refined with a short force pass.
+    // Same options, stats and snapshots as calculateForceDirectedLayout; 'iterations'
+    // counts all levels.
+    ForceLayoutStats calculateMultilevelLayout(std::shared_ptr<Node> root,
+                                               const ForceLayoutOptions& options = ForceLayoutOptions());
+
+    // Lays out again only the subtree below 'changed'  (e.g. after adding a child to it):
+    // its radial sector is recomputed, then a force pass runs over the subtree with
+    // 'changed' and every neighbour within E4Maps::INCREMENTAL_LAYOUT_MARGIN pinned, and
+    // overlap removal separates the subtree from the nodes around it. Neighbours are
+    // looked up in the map's spatial index and never move; node sizes are used as they
+    // are, so unmeasured nodes should carry an estimate.
+    // Gives up and restores the old positions (applied = false) when the subtree plus
+    // neighbourhood exceeds E4Maps::INCREMENTAL_LAYOUT_MAX_NODES; callers then fall back to
+    // the global layout. When more than E4Maps::INCREMENTAL_LAYOUT_OVERLAP_BUDGET overlaps
+    // are left, callers run the global removeOverlaps. The index entries of the moved
+    // nodes are left for the caller to update (MindMap::updateNodeBounds).
+    IncrementalLayoutResult calculateIncrementalLayout(MindMap& map, std::shared_ptr<Node> changed,
+                                                       const ForceLayoutOptions& options = ForceLayoutOptions());
+
+    // Pushes apart overlapping node boxes (measured width/height) until every pair is at
+    // least E4Maps::OVERLAP_REMOVAL_GAP apart, moving nodes as little as it can.
+    // Meant to run after any of the engines above, in O(n log n): a sweep line generates
+    // separation constraints, first sideways for pairs that are cheaper to separate that
+    // way, then vertically for everything else. The root and manualPosition nodes never
+    // move. onSnapshot, if set, receives the moved nodes as one final snapshot (same
+    // indices as the force-directed layout).
+    OverlapRemovalStats removeOverlaps(std::shared_ptr<Node> root,
+                                       const std::function<void(LayoutSnapshot&&)>& onSnapshot = nullptr);
+
+    // Same for part of a map, e.g. nodes that were just resized: 'nodes' and whatever
+    // they overlap, looked up in the map's spatial index, are separated; nodes pushed
+    // onto others take those along in further rounds. Returns the nodes that moved,
+    // whose bounds have been updated in the map already.
+    std::vector<std::shared_ptr<Node>> removeOverlaps(MindMap& map, const std::vector<std::shared_ptr<Node>>& nodes);
+
+    // A way of laying out a whole map, as picked by the user or by LayoutEngineRegistry.
+    // run() may be called from a worker thread, so engines keep no state of their own.
+    // Contract: run() honours options.cancel (a cancelled run leaves every node where it
+    // was and sets stats.cancelled) and reports progress through options.onSnapshot,
+    // ending with a final snapshot of everything it moved. The other option fields only
+    // tune the iterative engines.
+    class LayoutEngine {
+    public:
+        virtual ~LayoutEngine() = default;
+
+        // Stable identifier, stored in .e4m files
+        virtual const char* id() const = 0;
+        // Untranslated display name (marked for translation)
+        virtual const char* name() const = 0;
+
+        // Cheap placement done synchronously before run() starts in the background, so
+        // the map has a sensible shape in the meantime. Default: leave nodes alone.
+        virtual void seed(std::shared_ptr<Node> root) const { (void)root; }
+
+        virtual ForceLayoutStats run(std::shared_ptr<Node> root, const ForceLayoutOptions& options) const = 0;
+
+        // Expected run time on a single core, before the registry's own measurements
+        virtual double estimateMs(size_t nodeCount) const = 0;
+
+        // Whether calculateIncrementalLayout keeps results consistent with this engine
+        virtual bool supportsIncremental() const { return false; }
+
+        // Taken into account by LayoutEngineRegistry::choose
+        virtual bool automatic() const { return false; }
+    };
+
+    // The layout engines the application knows about. Automatic selection goes through
+    // them in registration order (nicest first) and takes the first whose estimated time
+    // fits the budget; estimates are corrected with the measured duration of every run.
+    // Not thread-safe: meant to be used from the UI thread only.
+    class LayoutEngineRegistry {
+    public:
+        LayoutEngineRegistry(); // Registers the built-in engines
+
+        void add(std::unique_ptr<LayoutEngine> engine);
+
+        const std::vector<std::unique_ptr<LayoutEngine>>& engines() const { return registered; }
+
+        // nullptr if no engine has this id
+        const LayoutEngine* find(const std::string& id) const;
+
+        // Engine for a map of nodeCount nodes: the first automatic one expected to finish
+        // within budgetMs, or the fastest automatic one if none does
+        const LayoutEngine* choose(size_t nodeCount, double budgetMs) const;
+
+        // Estimate corrected by the runs recorded so far
+        double estimateMs(const LayoutEngine& engine, size_t nodeCount) const;
+
+        void recordRun(const LayoutEngine& engine, const ForceLayoutStats& stats);
+
+    private:
+        std::vector<std::unique_ptr<LayoutEngine>> registered;
+        std::vector<double> slowdown; // Measured / estimated run time, per engine
+
+        size_t indexOf(const LayoutEngine& engine) const;
+    };
 
 } // namespace LayoutAlgorithms
 
-#endif // LAYOUT_ALGORITHM_HPP
\ No newline at end of file
+#endif // LAYOUT_ALGORITHM_HPP
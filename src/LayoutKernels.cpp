@@ -0,0 +1,182 @@
+#include "LayoutKernels.hpp"
+#include <cmath>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define E4MAPS_HAVE_AVX2_KERNEL 1
+#include <immintrin.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define E4MAPS_HAVE_SSE2_KERNEL 1
+#include <emmintrin.h>
+#endif
+
+namespace LayoutKernels {
+
+    namespace {
+
+        // Repulsion on node i from nodes [from, count), scalar.
+        // The self-interaction needs no special case: d = 0 contributes 0 * factor.
+        inline void repulsionTail(const double* x, const double* y, size_t from, size_t count,
+                                  double xi, double yi, double repulsion, double cutoffSq,
+                                  double& fx, double& fy) {
+            for (size_t j = from; j < count; j++) {
+                double dx = xi - x[j];
+                double dy = yi - y[j];
+                double distSq = dx * dx + dy * dy;
+                if (distSq > cutoffSq) continue;
+
+                double distance = std::sqrt(distSq) + 0.1; // Avoid division by zero
+                double factor = repulsion / (distance * distance * distance);
+                fx += factor * dx;
+                fy += factor * dy;
+            }
+        }
+
+        void repulsionScalar(LayoutArrays& s, size_t begin, size_t end, double repulsion, double cutoffSq) {
+            const size_t count = s.size();
+            for (size_t i = begin; i < end; i++) {
+                if (s.isFixed(i)) continue;
+                double fx = 0.0, fy = 0.0;
+                repulsionTail(s.x.data(), s.y.data(), 0, count, s.x[i], s.y[i], repulsion, cutoffSq, fx, fy);
+                s.fx[i] += fx;
+                s.fy[i] += fy;
+            }
+        }
+
+#ifdef E4MAPS_HAVE_SSE2_KERNEL
+        void repulsionSSE2(LayoutArrays& s, size_t begin, size_t end, double repulsion, double cutoffSq) {
+            const size_t count = s.size();
+            const size_t vecEnd = count & ~size_t(1);
+            const double* x = s.x.data();
+            const double* y = s.y.data();
+            const __m128d vRep = _mm_set1_pd(repulsion);
+            const __m128d vCutoff = _mm_set1_pd(cutoffSq);
+            const __m128d vEps = _mm_set1_pd(0.1);
+
+            for (size_t i = begin; i < end; i++) {
+                if (s.isFixed(i)) continue;
+                const __m128d xi = _mm_set1_pd(x[i]);
+                const __m128d yi = _mm_set1_pd(y[i]);
+                __m128d accX = _mm_setzero_pd();
+                __m128d accY = _mm_setzero_pd();
+
+                for (size_t j = 0; j < vecEnd; j += 2) {
+                    __m128d dx = _mm_sub_pd(xi, _mm_loadu_pd(x + j));
+                    __m128d dy = _mm_sub_pd(yi, _mm_loadu_pd(y + j));
+                    __m128d distSq = _mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy));
+                    __m128d inRange = _mm_cmple_pd(distSq, vCutoff);
+                    if (_mm_movemask_pd(inRange) == 0) continue; // Most pairs are beyond the cutoff
+                    __m128d distance = _mm_add_pd(_mm_sqrt_pd(distSq), vEps);
+                    __m128d factor = _mm_div_pd(vRep, _mm_mul_pd(distance, _mm_mul_pd(distance, distance)));
+                    factor = _mm_and_pd(factor, inRange);
+                    accX = _mm_add_pd(accX, _mm_mul_pd(factor, dx));
+                    accY = _mm_add_pd(accY, _mm_mul_pd(factor, dy));
+                }
+
+                double lanesX[2], lanesY[2];
+                _mm_storeu_pd(lanesX, accX);
+                _mm_storeu_pd(lanesY, accY);
+                double fx = lanesX[0] + lanesX[1];
+                double fy = lanesY[0] + lanesY[1];
+                repulsionTail(x, y, vecEnd, count, x[i], y[i], repulsion, cutoffSq, fx, fy);
+                s.fx[i] += fx;
+                s.fy[i] += fy;
+            }
+        }
+#endif
+
+#ifdef E4MAPS_HAVE_AVX2_KERNEL
+        __attribute__((target("avx2")))
+        void repulsionAVX2(LayoutArrays& s, size_t begin, size_t end, double repulsion, double cutoffSq) {
+            const size_t count = s.size();
+            const size_t vecEnd = count & ~size_t(3);
+            const double* x = s.x.data();
+            const double* y = s.y.data();
+            const __m256d vRep = _mm256_set1_pd(repulsion);
+            const __m256d vCutoff = _mm256_set1_pd(cutoffSq);
+            const __m256d vEps = _mm256_set1_pd(0.1);
+
+            for (size_t i = begin; i < end; i++) {
+                if (s.isFixed(i)) continue;
+                const __m256d xi = _mm256_set1_pd(x[i]);
+                const __m256d yi = _mm256_set1_pd(y[i]);
+                __m256d accX = _mm256_setzero_pd();
+                __m256d accY = _mm256_setzero_pd();
+
+                for (size_t j = 0; j < vecEnd; j += 4) {
+                    __m256d dx = _mm256_sub_pd(xi, _mm256_loadu_pd(x + j));
+                    __m256d dy = _mm256_sub_pd(yi, _mm256_loadu_pd(y + j));
+                    __m256d distSq = _mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy));
+                    __m256d inRange = _mm256_cmp_pd(distSq, vCutoff, _CMP_LE_OQ);
+                    if (_mm256_movemask_pd(inRange) == 0) continue; // Most pairs are beyond the cutoff
+                    __m256d distance = _mm256_add_pd(_mm256_sqrt_pd(distSq), vEps);
+                    __m256d factor = _mm256_div_pd(vRep, _mm256_mul_pd(distance, _mm256_mul_pd(distance, distance)));
+                    factor = _mm256_and_pd(factor, inRange);
+                    accX = _mm256_add_pd(accX, _mm256_mul_pd(factor, dx));
+                    accY = _mm256_add_pd(accY, _mm256_mul_pd(factor, dy));
+                }
+
+                double lanesX[4], lanesY[4];
+                _mm256_storeu_pd(lanesX, accX);
+                _mm256_storeu_pd(lanesY, accY);
+                double fx = (lanesX[0] + lanesX[1]) + (lanesX[2] + lanesX[3]);
+                double fy = (lanesY[0] + lanesY[1]) + (lanesY[2] + lanesY[3]);
+                repulsionTail(x, y, vecEnd, count, x[i], y[i], repulsion, cutoffSq, fx, fy);
+                s.fx[i] += fx;
+                s.fy[i] += fy;
+            }
+        }
+#endif
+
+    } // namespace
+
+    Isa detectIsa() {
+#ifdef E4MAPS_HAVE_AVX2_KERNEL
+        static const bool hasAvx2 = __builtin_cpu_supports("avx2");
+        if (hasAvx2) return Isa::AVX2;
+#endif
+#ifdef E4MAPS_HAVE_SSE2_KERNEL
+        return Isa::SSE2;
+#else
+        return Isa::Scalar;
+#endif
+    }
+
+    const char* isaName(Isa isa) {
+        switch (isa) {
+            case Isa::AVX2: return "avx2";
+            case Isa::SSE2: return "sse2";
+            default: return "scalar";
+        }
+    }
+
+    void accumulateRepulsion(LayoutArrays& state, size_t begin, size_t end,
+                             double repulsion, double cutoffSq) {
+        static const Isa isa = detectIsa();
+        accumulateRepulsion(isa, state, begin, end, repulsion, cutoffSq);
+    }
+
+    void accumulateRepulsion(Isa isa, LayoutArrays& state, size_t begin, size_t end,
+                             double repulsion, double cutoffSq) {
+        switch (isa) {
+#ifdef E4MAPS_HAVE_AVX2_KERNEL
+            case Isa::AVX2:
+                if (detectIsa() == Isa::AVX2) {
+                    repulsionAVX2(state, begin, end, repulsion, cutoffSq);
+                    return;
+                }
+                break;
+#endif
+#ifdef E4MAPS_HAVE_SSE2_KERNEL
+            case Isa::SSE2:
+                repulsionSSE2(state, begin, end, repulsion, cutoffSq);
+                return;
+#endif
+            default:
+                break;
+        }
+        repulsionScalar(state, begin, end, repulsion, cutoffSq);
+    }
+
+} // namespace LayoutKernels
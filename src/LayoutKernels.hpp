@@ -0,0 +1,68 @@
+#ifndef LAYOUT_KERNELS_HPP
+#define LAYOUT_KERNELS_HPP
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Low-level force kernels shared by the layout engines.
+// Nothing in here knows about Node: the state is kept in packed arrays so the hot
+// loops only touch the coordinates they need and can be vectorised.
+namespace LayoutKernels {
+
+    // Structure-of-arrays layout state
+    struct LayoutArrays {
+        std::vector<double> x, y;   // Positions
+        std::vector<double> fx, fy; // Accumulated forces
+        std::vector<uint64_t> fixedMask; // Bit i set = node i never moves
+        std::vector<double> mass; // Optional repulsion weight per node, empty = all 1.
+                                  // Not sized by resize(); the exact kernels ignore it.
+
+        size_t size() const { return x.size(); }
+
+        double massOf(size_t i) const { return mass.empty() ? 1.0 : mass[i]; }
+
+        void resize(size_t count) {
+            x.resize(count, 0.0);
+            y.resize(count, 0.0);
+            fx.resize(count, 0.0);
+            fy.resize(count, 0.0);
+            fixedMask.resize((count + 63) / 64, 0);
+        }
+
+        bool isFixed(size_t i) const { return (fixedMask[i >> 6] >> (i & 63)) & 1u; }
+
+        void setFixed(size_t i, bool fixed) {
+            if (fixed) fixedMask[i >> 6] |= (uint64_t(1) << (i & 63));
+            else fixedMask[i >> 6] &= ~(uint64_t(1) << (i & 63));
+        }
+    };
+
+    // Instruction sets the repulsion kernel can run on
+    enum class Isa {
+        Scalar,
+        SSE2,
+        AVX2
+    };
+
+    // Best instruction set supported by both the build and the running CPU
+    Isa detectIsa();
+
+    const char* isaName(Isa isa);
+
+    // Exact all-pairs repulsion for the movable nodes in [begin, end):
+    // adds repulsion * d / (|d| + 0.1)^3 for every other node closer than sqrt(cutoffSq)
+    // to fx/fy. Fixed nodes act as sources but are not updated.
+    // The vector paths sum in a different order from the scalar one, so results agree
+    // to rounding, not bit for bit.
+    void accumulateRepulsion(LayoutArrays& state, size_t begin, size_t end,
+                             double repulsion, double cutoffSq);
+
+    // Same as above with an explicit instruction set (falls back to scalar when the
+    // requested one is not available). Used by the benchmark.
+    void accumulateRepulsion(Isa isa, LayoutArrays& state, size_t begin, size_t end,
+                             double repulsion, double cutoffSq);
+
+} // namespace LayoutKernels
+
+#endif // LAYOUT_KERNELS_HPP
@@ -1,4 +1,5 @@
 #include "MainWindow.hpp"
+#include "TextLayoutCache.hpp"
 
 MainWindow::MainWindow() : m_VBox(Gtk::ORIENTATION_VERTICAL),
                    m_Map(std::make_shared<MindMap>(_("MAIN IDEA"))),
@@ -26,6 +27,8 @@ MainWindow::MainWindow() : m_VBox(Gtk::ORIENTATION_VERTICAL),
     m_Area.signal_edit_node.connect(sigc::mem_fun(*this, &MainWindow::open_edit_dialog));
     m_Area.signal_map_modified.connect(sigc::mem_fun(*this, &MainWindow::on_map_modified));
     m_Area.signal_node_context_menu.connect(sigc::mem_fun(*this, &MainWindow::on_node_context_menu));
+    m_Area.signal_layout_finished.connect(sigc::mem_fun(*this, &MainWindow::on_layout_finished));
+    applySettings();
     m_Area.set_hexpand(true); m_Area.set_vexpand(true);
     
     // Setup Overlay for inline editing
@@ -43,6 +46,27 @@ MainWindow::MainWindow() : m_VBox(Gtk::ORIENTATION_VERTICAL),
     m_EditorScroll.hide(); // Ensure hidden after show_all
 }
 
+void MainWindow::applySettings() {
+    // Force-directed layout, e.g. "layout.repulsion = barnes-hut" or "layout.threads = 2"
+    LayoutAlgorithms::ForceLayoutOptions options;
+    std::string repulsion = m_configManager.getSetting("layout.repulsion", "auto");
+    if (repulsion == "exact") options.repulsion = LayoutAlgorithms::RepulsionMethod::Exact;
+    else if (repulsion == "barnes-hut") options.repulsion = LayoutAlgorithms::RepulsionMethod::BarnesHut;
+    options.theta = m_configManager.getNumberSetting("layout.theta", options.theta);
+    options.threads = (unsigned)std::max(0.0, m_configManager.getNumberSetting("layout.threads", options.threads));
+    options.maxIterations = (int)std::max(1.0, m_configManager.getNumberSetting("layout.max_iterations", options.maxIterations));
+    options.displacementTolerance = m_configManager.getNumberSetting("layout.displacement_tolerance", options.displacementTolerance);
+    options.energyTolerance = m_configManager.getNumberSetting("layout.energy_tolerance", options.energyTolerance);
+    options.initialStep = m_configManager.getNumberSetting("layout.initial_step", options.initialStep);
+    options.coolingFactor = m_configManager.getNumberSetting("layout.cooling_factor", options.coolingFactor);
+    m_Area.setLayoutOptions(options);
+
+    // Memory for shaped node text shared by all maps, e.g. "text_cache.max_mb = 64"
+    const double megabyte = 1024.0 * 1024.0;
+    double cacheMb = m_configManager.getNumberSetting("text_cache.max_mb", E4Maps::TEXT_LAYOUT_CACHE_MAX_BYTES / megabyte);
+    TextLayoutCache::getInstance().setMaxBytes((size_t)(std::max(1.0, cacheMb) * megabyte));
+}
+
 void MainWindow::setupInlineEditor() {
     // Setup Inline Editor
     m_InlineEditor.set_wrap_mode(Gtk::WRAP_WORD);
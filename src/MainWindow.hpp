@@ -61,6 +61,10 @@ class MainWindow : public Gtk::Window {
     ConfigManager m_configManager;
     Gtk::Menu* m_recentMenu = nullptr;
 
+    // Layout engine choice: one radio item per engine id ("" = automatic)
+    std::vector<std::pair<std::string, Gtk::RadioMenuItem*>> m_layoutItems;
+    bool m_syncingLayoutMenu = false;
+
 public:
     MainWindow();
 
@@ -71,8 +75,10 @@ private:
     void saveRecentFiles();
     void addToRecent(const std::string& path);
     void rebuildRecentMenu();
+    void syncLayoutMenu(); // Reflects the engine pinned to the current map
 
     void initHeaderBar();
+    void applySettings(); // Tuning read from the configuration directory
 
 public:
     void openFile(const std::string& path) { open_file_internal(path); }
@@ -99,6 +105,8 @@ private:
     void on_cut();
     void on_paste();
     void on_edit_theme();
+    void on_layout_engine(const std::string& id);
+    void on_layout_finished(const LayoutAlgorithms::ForceLayoutStats& stats);
     void on_help_guide();
 
     // Inline editing methods
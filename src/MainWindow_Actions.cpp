@@ -5,6 +5,7 @@
 #include "Utils.hpp"  // Include our utility functions
 #include <algorithm>
 #include <cstdlib> // For std::getenv
+#include <cstdio>
 
 #ifdef __APPLE__
 #include <mach-o/dyld.h>
@@ -70,6 +71,7 @@ void MainWindow::open_file_internal(const std::string& path) {
         }
         m_Map = newMap;
         m_Area.setMap(m_Map);
+        syncLayoutMenu();
         m_currentFilename = path;
         m_commandManager.clear();  // Clear command history when loading new file
         set_title("E4maps - " + Glib::path_get_basename(path));
@@ -299,7 +301,7 @@ void MainWindow::on_add_node() {
     auto addCmd = std::make_unique<AddNodeCommand>(selected, newNode);
     m_commandManager.executeCommand(std::move(addCmd));
 
-    m_Area.invalidateLayout();
+    m_Area.invalidateLayout(selected); // Only the parent's subtree needs to move
     setModified(true);
     open_edit_dialog(newNode);
 }
@@ -313,6 +315,7 @@ void MainWindow::on_new() {
     // Create a new empty map
     m_Map = std::make_shared<MindMap>(_("MAIN IDEA"));
     m_Area.setMap(m_Map);
+    syncLayoutMenu();
     m_currentFilename.clear();
     m_commandManager.clear();  // Clear command history for new document
     setModified(false);  // New document is not modified initially
@@ -381,7 +384,9 @@ void MainWindow::open_edit_dialog(std::shared_ptr<Node> node) {
 
         // Note: The node values are updated by the command execution
 
-        m_Area.invalidateLayout();
+        // A new size only affects the node's siblings and their subtrees
+        if (auto parent = node->parent.lock()) m_Area.invalidateLayout(parent);
+        else m_Area.invalidateLayout();
         setModified(true);
     }
 }
@@ -478,7 +483,7 @@ void MainWindow::on_paste() {
     m_Area.setSelectedNodes(pasteCmdPtr->getPastedNodes());
 
     setModified(true);
-    m_Area.invalidateLayout();
+    m_Area.invalidateLayout(selected);
 }
 
 void MainWindow::on_edit_theme() {
@@ -490,6 +495,24 @@ void MainWindow::on_edit_theme() {
     }
 }
 
+void MainWindow::on_layout_engine(const std::string& id) {
+    if (m_syncingLayoutMenu || id == m_Map->layoutEngine) return;
+    m_Area.setLayoutEngine(id);
+    setModified(true);
+}
+
+void MainWindow::on_layout_finished(const LayoutAlgorithms::ForceLayoutStats& stats) {
+    char message[256];
+    if (stats.iterations == 0) { // Engines that place nodes directly
+        snprintf(message, sizeof(message), _("Layout: %zu nodes in %.0f ms"), stats.nodeCount, stats.totalMs);
+    } else {
+        snprintf(message, sizeof(message), _("Layout: %d iterations in %.0f ms (%.2f ms each), final energy %.3g%s"),
+                 stats.iterations, stats.totalMs, stats.msPerIteration, stats.finalEnergy,
+                 stats.converged ? "" : _(", stopped at the iteration limit"));
+    }
+    updateStatusBar(message);
+}
+
 void MainWindow::on_help_guide() {
     std::string filename = "user_guide_en.html";
 
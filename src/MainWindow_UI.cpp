@@ -1,6 +1,8 @@
 #include "MainWindow.hpp"
 #include "ThemeEditor.hpp"
 #include "Exporter.hpp"
+#include "TextLayoutCache.hpp"
+#include <cstdio>
 
 void MainWindow::initHeaderBar() {
     m_HeaderBar.set_show_close_button(true);
@@ -123,6 +125,29 @@ void MainWindow::initHeaderBar() {
     
     menu->append(*itemView);
 
+    // --- Layout Section ---
+    auto itemLayout = Gtk::manage(new Gtk::MenuItem(_("Layout")));
+    auto layoutSubMenu = Gtk::manage(new Gtk::Menu());
+    itemLayout->set_submenu(*layoutSubMenu);
+
+    Gtk::RadioMenuItem::Group layoutGroup;
+    auto addLayoutItem = [&](const std::string& id, const Glib::ustring& label) {
+        auto item = Gtk::manage(new Gtk::RadioMenuItem(layoutGroup, label));
+        item->signal_toggled().connect([this, item, id]() {
+            if (item->get_active()) on_layout_engine(id);
+        });
+        layoutSubMenu->append(*item);
+        m_layoutItems.push_back({id, item});
+    };
+    addLayoutItem("", _("Automatic"));
+    layoutSubMenu->append(*Gtk::manage(new Gtk::SeparatorMenuItem()));
+    for (const auto& engine : m_Area.getLayoutEngines().engines()) {
+        addLayoutItem(engine->id(), _(engine->name()));
+    }
+    syncLayoutMenu();
+
+    menu->append(*itemLayout);
+
     // --- Export Section ---
     auto itemExport = Gtk::manage(new Gtk::MenuItem(_("Export")));
     auto exportSubMenu = Gtk::manage(new Gtk::Menu());
@@ -184,6 +209,18 @@ void MainWindow::rebuildRecentMenu() {
     m_recentMenu->show_all();
 }
 
+void MainWindow::syncLayoutMenu() {
+    if (m_layoutItems.empty()) return;
+    // Ids this build does not know fall back to automatic, like the layout itself does
+    Gtk::RadioMenuItem* active = m_layoutItems.front().second;
+    for (const auto& [id, item] : m_layoutItems) {
+        if (id == m_Map->layoutEngine) active = item;
+    }
+    m_syncingLayoutMenu = true;
+    active->set_active(true);
+    m_syncingLayoutMenu = false;
+}
+
 void MainWindow::updateStatusBar(const std::string& message) {
     m_StatusBar.pop(m_StatusContextId);  // Clear previous message
     m_StatusBar.push(message, m_StatusContextId);  // Push new message
@@ -194,7 +231,14 @@ void MainWindow::on_about() {
     dialog.set_program_name(_("E4Maps"));
     dialog.set_version(_("1.0.0"));
     dialog.set_copyright(_("Copyright (c) 2025 Dorian Soru <doriansoru@gmail.com>"));
-    dialog.set_comments(_("A simple mind mapping application"));
+    // Diagnostics below the description, for tuning text_cache.max_mb
+    const double megabyte = 1024.0 * 1024.0;
+    TextLayoutCache::Stats cache = TextLayoutCache::getInstance().stats();
+    char cacheLine[256];
+    snprintf(cacheLine, sizeof(cacheLine), _("Text layout cache: %zu entries, %.1f of %.0f MB, %.0f%% hits, %llu evictions"),
+             cache.entries, cache.bytes / megabyte, cache.maxBytes / megabyte, cache.hitRate() * 100.0,
+             (unsigned long long)cache.evictions);
+    dialog.set_comments(std::string(_("A simple mind mapping application")) + "\n\n" + cacheLine);
     dialog.set_license_type(Gtk::LICENSE_GPL_3_0);
     dialog.set_website("https://github.com/doriansoru/e4maps");
     dialog.set_website_label(_("GitHub Repository"));
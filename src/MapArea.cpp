@@ -9,7 +9,28 @@
 MapArea::MapArea(std::shared_ptr<MindMap> m) : drawingContext(m) {
     add_events(Gdk::BUTTON_PRESS_MASK | Gdk::BUTTON_RELEASE_MASK |
                Gdk::POINTER_MOTION_MASK | Gdk::SCROLL_MASK);
+    drawingContext.setAnimationCallback([this](){ this->startLayoutAnimation(); });
     drawingContext.setRedrawCallback([this](){ this->queue_draw(); });
+    drawingContext.setLayoutFinishedCallback([this](const LayoutAlgorithms::ForceLayoutStats& stats) {
+        signal_layout_finished.emit(stats);
+    });
+}
+
+void MapArea::startLayoutAnimation() {
+    if (layoutTickId != 0) return; // Already ticking, the new targets are picked up
+    lastLayoutFrameTime = 0;
+    layoutTickId = add_tick_callback(sigc::mem_fun(*this, &MapArea::onLayoutTick));
+}
+
+bool MapArea::onLayoutTick(const Glib::RefPtr<Gdk::FrameClock>& clock) {
+    gint64 now = clock->get_frame_time(); // Microseconds
+    double seconds = lastLayoutFrameTime ? (now - lastLayoutFrameTime) / 1e6 : 1.0 / 60.0;
+    lastLayoutFrameTime = now;
+
+    bool running = drawingContext.advanceLayoutAnimation(seconds);
+    queue_draw();
+    if (!running) layoutTickId = 0;
+    return running; // false removes the callback
 }
 
 void MapArea::setMap(std::shared_ptr<MindMap> m) {
@@ -23,7 +44,19 @@ void MapArea::setMap(std::shared_ptr<MindMap> m) {
 
 void MapArea::setSelectedNodes(const std::vector<std::shared_ptr<Node>>& nodes) {
     drawingContext.setSelectedNodes(nodes);
-    queue_draw();
+    queueDamage();
+}
+
+void MapArea::queueDamage() {
+    Gtk::Allocation allocation = get_allocation();
+    std::vector<Gdk::Rectangle> areas;
+    if (!drawingContext.takeScreenDamage(allocation.get_width(), allocation.get_height(), areas)) {
+        queue_draw();
+        return;
+    }
+    for (const auto& area : areas) {
+        queue_draw_area(area.get_x(), area.get_y(), area.get_width(), area.get_height());
+    }
 }
 
 bool MapArea::on_button_press_event(GdkEventButton* event) {
@@ -39,7 +72,7 @@ bool MapArea::on_button_press_event(GdkEventButton* event) {
         if (clickedNode) {
             // Select the node user clicked on (good UX)
             drawingContext.setSelectedNode(clickedNode);
-            queue_draw();
+            queueDamage();
             
             // Emit signal for main window to show menu
             signal_node_context_menu.emit(event, clickedNode);
@@ -55,21 +88,68 @@ bool MapArea::on_button_press_event(GdkEventButton* event) {
     if (event->type == GDK_2BUTTON_PRESS && clickedNode) {
         drawingContext.setSelectedNode(clickedNode);
         signal_edit_node.emit(clickedNode);
-        queue_draw();
+        queueDamage();
         return true;
     }
     
     if (clickedNode) {
         return handleNodeSelection(event, clickedNode);
     } else {
-        // Clicked on empty space - clear selection
-        bool isCtrlPressed = (event->state & GDK_CONTROL_MASK) != 0;
-        if (!isCtrlPressed) {
-            drawingContext.clearSelection();
-        }
+        // Clicked on empty space - clear selection, or start a rubber band with the
+        // left button (which clears it too unless Shift is held)
         isDragging = false;
+        if (event->type == GDK_BUTTON_PRESS && event->button == 1) {
+            return handleAreaSelectionStart(event);
+        }
+        drawingContext.clearSelection();
     }
-    queue_draw();
+    queueDamage();
+    return true;
+}
+
+bool MapArea::handleAreaSelectionStart(GdkEventButton* event) {
+    isSelectingArea = true;
+    // Only Shift: Ctrl on empty canvas pans instead
+    isAreaAdditive = (event->state & GDK_SHIFT_MASK) != 0;
+    dragStartX = event->x;
+    dragStartY = event->y;
+    if (!isAreaAdditive) {
+        drawingContext.clearSelection();
+        queueDamage();
+    }
+    return true;
+}
+
+bool MapArea::handleAreaSelectionMove(GdkEventMotion* event) {
+    // Only the strip swept since the last event is repainted, and the map under it
+    // comes from the drawing context's cached layer
+    Gdk::Rectangle damage = drawingContext.marqueeScreenRect();
+    drawingContext.setMarquee(dragStartX, dragStartY, event->x, event->y);
+    Gdk::Rectangle current = drawingContext.marqueeScreenRect();
+    if (damage.has_zero_area()) {
+        damage = current;
+    } else {
+        damage.join(current);
+    }
+    queue_draw_area(damage.get_x(), damage.get_y(), damage.get_width(), damage.get_height());
+    return true;
+}
+
+bool MapArea::handleAreaSelectionEnd(GdkEventButton* event) {
+    isSelectingArea = false;
+    if (drawingContext.marqueeScreenRect().has_zero_area()) return true; // Plain click
+
+    Gtk::Allocation allocation = get_allocation();
+    const int width = allocation.get_width();
+    const int height = allocation.get_height();
+    auto [x0, y0] = drawingContext.screenToWorld(dragStartX, dragStartY, width, height);
+    auto [x1, y1] = drawingContext.screenToWorld(event->x, event->y, width, height);
+    drawingContext.selectNodesInRect(std::min(x0, x1), std::min(y0, y1),
+                                     std::max(x0, x1), std::max(y0, y1), isAreaAdditive);
+    Gdk::Rectangle marquee = drawingContext.marqueeScreenRect();
+    drawingContext.clearMarquee();
+    queue_draw_area(marquee.get_x(), marquee.get_y(), marquee.get_width(), marquee.get_height());
+    queueDamage();
     return true;
 }
 
@@ -101,7 +181,7 @@ bool MapArea::handleNodeSelection(GdkEventButton* event, std::shared_ptr<Node> c
         if (isAlreadySelected && hasMultipleSelection) {
             // The clicked node is part of a multi-selection, prepare to drag all selected nodes
             // Set it as the primary selected node to bring it to front if needed
-            drawingContext.setSelectedNode(clickedNode);  // This ensures clicked node becomes primary selection
+            drawingContext.setPrimarySelectedNode(clickedNode);  // Keeps the others selected so they move together
 
             // Prepare for potential dragging with threshold
             isPreDragging = true;  // Indicate potential drag, will confirm on motion
@@ -129,7 +209,7 @@ bool MapArea::handleNodeSelection(GdkEventButton* event, std::shared_ptr<Node> c
     }
 
     // Queue redraw to update visual representation of selection immediately
-    queue_draw();
+    queueDamage();
     return true;
 }
 
@@ -143,8 +223,16 @@ bool MapArea::handlePanningStart(GdkEventButton* event) {
 }
 
 bool MapArea::on_button_release_event(GdkEventButton* event) {
+    if (isSelectingArea) {
+        return handleAreaSelectionEnd(event);
+    }
+
     // If we were in pre-drag state but didn't exceed threshold, node is selected but not dragged
     // If we were in actual dragging state, dragging stops
+    if (drawingContext.isLayeredDragActive()) {
+        drawingContext.endLayeredDrag();
+        queueDamage();
+    }
     isDragging = false;
     isPanning = false;
     isPreDragging = false;
@@ -155,6 +243,8 @@ bool MapArea::on_button_release_event(GdkEventButton* event) {
 bool MapArea::on_motion_notify_event(GdkEventMotion* event) {
     if (isPanning) {
         return handlePanningMove(event);
+    } else if (isSelectingArea) {
+        return handleAreaSelectionMove(event);
     } else if (isPreDragging && !isDragging) {
         // Check if mouse has moved beyond drag threshold to start actual dragging
         const double DRAG_THRESHOLD = 3.0; // Threshold in pixels to start dragging
@@ -165,16 +255,34 @@ bool MapArea::on_motion_notify_event(GdkEventMotion* event) {
             isDragging = true;
             isFirstDragMotion = true;  // Reset for this drag operation
             // No need to re-select here as the node is already selected from button press
+            startLayeredDrag();
         } else {
             // Mouse hasn't moved enough, still in pre-drag state
             return true;
         }
     } else if (isDragging) {
         return handleNodeDragMove(event);
+    } else {
+        updateHoverCursor(event->x, event->y);
     }
     return false;
 }
 
+void MapArea::updateHoverCursor(double screenX, double screenY) {
+    Gtk::Allocation allocation = get_allocation();
+    bool overNode = drawingContext.hitTest(screenX, screenY, allocation.get_width(), allocation.get_height()) != nullptr;
+    if (overNode == isHoveringNode) return;
+    isHoveringNode = overNode;
+
+    auto window = get_window();
+    if (!window) return;
+    if (overNode) {
+        window->set_cursor(Gdk::Cursor::create(get_display(), "pointer"));
+    } else {
+        window->set_cursor(); // Back to the parent window's cursor
+    }
+}
+
 bool MapArea::handlePanningMove(GdkEventMotion* event) {
     double dx = event->x - dragStartX;
     double dy = event->y - dragStartY;
@@ -188,7 +296,7 @@ bool MapArea::handlePanningMove(GdkEventMotion* event) {
 
 bool MapArea::handleNodeDragMove(GdkEventMotion* event) {
     // Check which dragging mode we're in: single node or multiple nodes
-    auto selectedNodes = drawingContext.getSelectedNodes();
+    const auto& selectedNodes = drawingContext.getSelectedNodes();
     if (selectedNodes.empty()) return false;
 
     // Dragging nodes: update position incrementally
@@ -221,25 +329,51 @@ bool MapArea::handleNodeDragMove(GdkEventMotion* event) {
         prevMouseWorldY = worldCurrentY;
     }
 
+    // Nodes still gliding to a layout position would fight the drag
+    drawingContext.finishLayoutAnimation();
+
     // Move all selected nodes by the same delta
     for (auto& node : selectedNodes) {
-        if (node) {
+        if (node && !hasSelectedAncestor(node)) {
             // Apply the incremental offset to the current node position
             node->x += deltaX;
             node->y += deltaY;
             node->manualPosition = true;
+            drawingContext.updateNodeBounds(*node);
 
             // Move the entire subtree by the same incremental offset
             moveSubtree(node, deltaX, deltaY);
         }
     }
 
-    queue_draw();
+    // Only the old and new places of what moved are repainted
+    if (drawingContext.isLayeredDragActive()) {
+        Gdk::Rectangle damage = drawingContext.layeredDragDamage();
+        queue_draw_area(damage.get_x(), damage.get_y(), damage.get_width(), damage.get_height());
+    } else {
+        queueDamage();
+    }
     // Signal that the map has been modified
     signal_map_modified.emit();
     return true;
 }
 
+void MapArea::startLayeredDrag() {
+    auto window = get_window();
+    if (!window) return;
+
+    std::vector<std::shared_ptr<Node>> branches;
+    for (const auto& node : drawingContext.getSelectedNodes()) {
+        if (node && !hasSelectedAncestor(node)) branches.push_back(node);
+    }
+
+    Gtk::Allocation allocation = get_allocation();
+    drawingContext.beginLayeredDrag(branches, allocation.get_width(), allocation.get_height(),
+        [&window](Cairo::Content content, int width, int height) {
+            return window->create_similar_surface(content, width, height);
+        });
+}
+
 bool MapArea::on_scroll_event(GdkEventScroll* event) {
     // Handle zoom with scroll wheel (reduce zoom factor to make it much less aggressive)
     double zoomFactor = (event->direction == GDK_SCROLL_UP) ? 1.05 : 1.0/1.05;
@@ -262,6 +396,15 @@ bool MapArea::on_configure_event(GdkEventConfigure* event) {
     return Gtk::DrawingArea::on_configure_event(event);
 }
 
+void MapArea::on_screen_changed(const Glib::RefPtr<Gdk::Screen>& previous_screen) {
+    Gtk::DrawingArea::on_screen_changed(previous_screen);
+    if (!previous_screen) return; // First time on a screen: nothing measured for another one yet
+
+    // Another screen may render fonts at another resolution
+    drawingContext.invalidateTextLayouts();
+    queue_draw();
+}
+
 void MapArea::zoomAtPoint(double factor, double screenX, double screenY) {
     Viewport vp = drawingContext.getViewport();
     
@@ -308,6 +451,14 @@ void MapArea::resetView() {
     queue_draw();
 }
 
+bool MapArea::hasSelectedAncestor(const std::shared_ptr<Node>& node) const {
+    // Such a node already moves with that ancestor's subtree
+    for (auto parent = node->parent.lock(); parent; parent = parent->parent.lock()) {
+        if (drawingContext.isNodeSelected(parent)) return true;
+    }
+    return false;
+}
+
 void MapArea::moveSubtree(std::shared_ptr<Node> node, double dx, double dy) {
     if (!node) return;
 
@@ -318,6 +469,7 @@ void MapArea::moveSubtree(std::shared_ptr<Node> node, double dx, double dy) {
         child->x += dx;
         child->y += dy;
         child->manualPosition = true;  // Mark as manually positioned
+        drawingContext.updateNodeBounds(*child);
 
         // Recursively move the child's subtree
         moveSubtree(child, dx, dy);
@@ -353,3 +505,13 @@ void MapArea::invalidateLayout() {
     drawingContext.invalidateLayout();
     queue_draw();
 }
+
+void MapArea::invalidateLayout(std::shared_ptr<Node> changed) {
+    drawingContext.invalidateLayout(changed);
+    queue_draw();
+}
+
+void MapArea::setLayoutEngine(const std::string& id) {
+    drawingContext.setLayoutEngine(id);
+    queue_draw();
+}
@@ -15,17 +15,25 @@ class MapArea : public Gtk::DrawingArea {
     bool isDragging = false;
     bool isPanning = false;
     bool isPreDragging = false;  // Flag to indicate potential dragging (for threshold detection)
+    bool isSelectingArea = false; // Rubber-band selection from empty canvas
+    bool isAreaAdditive = false;  // Shift held: the rubber band adds to the selection
     double dragStartX, dragStartY;
     double panStartOffsetX, panStartOffsetY;
     double nodeStartX, nodeStartY;
     // Track previous mouse position for smooth incremental movement
     double prevMouseWorldX, prevMouseWorldY;
     bool isFirstDragMotion = true;
+    bool isHoveringNode = false; // Pointer cursor shown over a node
+
+    // Frame-clock driven animation towards the positions of a running layout
+    guint layoutTickId = 0;
+    gint64 lastLayoutFrameTime = 0;
 
 public:
     sigc::signal<void, std::shared_ptr<Node>> signal_edit_node;
     sigc::signal<void, GdkEventButton*, std::shared_ptr<Node>> signal_node_context_menu;
     sigc::signal<void> signal_map_modified;
+    sigc::signal<void, const LayoutAlgorithms::ForceLayoutStats&> signal_layout_finished;
 
     explicit MapArea(std::shared_ptr<MindMap> m);
     ~MapArea() override = default;
@@ -41,6 +49,13 @@ public:
     double getScale() const { return drawingContext.getViewport().scale; }
 
     void invalidateLayout();
+    void invalidateLayout(std::shared_ptr<Node> changed); // Local re-layout below 'changed'
+
+    const LayoutAlgorithms::LayoutEngineRegistry& getLayoutEngines() const { return drawingContext.getLayoutEngines(); }
+    void setLayoutEngine(const std::string& id); // "" = choose automatically
+
+    void setLayoutOptions(const LayoutAlgorithms::ForceLayoutOptions& options) { drawingContext.setLayoutOptions(options); }
+    const LayoutAlgorithms::ForceLayoutStats& getLastLayoutStats() const { return drawingContext.getLastLayoutStats(); }
 
     void zoomIn();
     void zoomOut();
@@ -58,6 +73,7 @@ protected:
     bool on_scroll_event(GdkEventScroll* event) override;
     bool on_draw(const Cairo::RefPtr<Cairo::Context>& cr) override;
     bool on_configure_event(GdkEventConfigure* event) override;
+    void on_screen_changed(const Glib::RefPtr<Gdk::Screen>& previous_screen) override;
 
 private:
     // Event handling helpers
@@ -65,6 +81,21 @@ private:
     bool handlePanningStart(GdkEventButton* event);
     bool handlePanningMove(GdkEventMotion* event);
     bool handleNodeDragMove(GdkEventMotion* event);
+    bool handleAreaSelectionStart(GdkEventButton* event);
+    bool handleAreaSelectionMove(GdkEventMotion* event);
+    bool handleAreaSelectionEnd(GdkEventButton* event);
+    void updateHoverCursor(double screenX, double screenY);
+
+    // Repaints only what changed since the last frame (queue_draw() when that is everything)
+    void queueDamage();
+
+    // Renders the map around the selected branches once, so a drag only moves a layer
+    void startLayeredDrag();
+
+    void startLayoutAnimation();
+    bool onLayoutTick(const Glib::RefPtr<Gdk::FrameClock>& clock);
+
+    bool hasSelectedAncestor(const std::shared_ptr<Node>& node) const;
 
     // Helper method to move an entire subtree by an offset
     void moveSubtree(std::shared_ptr<Node> node, double dx, double dy);
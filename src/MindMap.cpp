@@ -27,13 +27,48 @@ Node::Node(const std::string& t, Color c) : text(t), color(c), id(generateId())
 }
 
 void Node::addChild(std::shared_ptr<Node> child) {
+    insertChild(children.size(), std::move(child));
+}
+
+void Node::insertChild(size_t position, std::shared_ptr<Node> child) {
     child->parent = weak_from_this();
-    children.push_back(child);
+    child->newlyAttached = true;
+    position = std::min(position, children.size());
+    children.insert(children.begin() + position, child);
+    renumberChildren(position);
+    child->markSizeDirty(); // Its depth, and so its style, may have changed
+    markChildrenChanged();
 }
 
 void Node::removeChild(std::shared_ptr<Node> child) {
-    auto it = std::remove(children.begin(), children.end(), child);
-    children.erase(it, children.end());
+    auto it = std::find(children.begin(), children.end(), child);
+    if (it == children.end()) return;
+    size_t position = it - children.begin();
+    children.erase(std::remove(it, children.end(), child), children.end());
+    renumberChildren(position);
+    markChildrenChanged();
+}
+
+void Node::renumberChildren(size_t from) {
+    for (size_t i = from; i < children.size(); ++i) children[i]->childIndex = i;
+}
+
+void Node::markChildrenChanged() {
+    // Same scheme as markSizeDirty
+    childrenChanged = true;
+    subtreeChanged = true;
+    for (auto p = parent.lock(); p && !p->subtreeChanged; p = p->parent.lock()) {
+        p->subtreeChanged = true;
+    }
+}
+
+void Node::markSizeDirty() {
+    // A marked node always has marked ancestors, so the walk up stops at the first one
+    sizeDirty = true;
+    subtreeSizeDirty = true;
+    for (auto p = parent.lock(); p && !p->subtreeSizeDirty; p = p->parent.lock()) {
+        p->subtreeSizeDirty = true;
+    }
 }
 
 bool Node::isRoot() const { return parent.expired(); }
@@ -197,23 +232,342 @@ MindMap::MindMap(const std::string& rootText) {
 
 MindMap::MindMap() {}
 
-std::shared_ptr<Node> MindMap::hitTestRecursive(std::shared_ptr<Node> node, double x, double y) {
-    if (!node) return nullptr;
-    
-    // Check children first (reverse order to pick the one drawn last/on top)
-    for (auto it = node->children.rbegin(); it != node->children.rend(); ++it) {
-        auto found = hitTestRecursive(*it, x, y);
-        if (found) return found;
+namespace {
+    // Rectangle the hit test accepts for a node, see Node::contains
+    SpatialIndex::Rect hitBounds(const Node& node) {
+        double margin = E4Maps::NODE_MARGIN;
+        return {node.x - node.width/2 - margin, node.y - node.height/2 - margin,
+                node.x + node.width/2 + margin, node.y + node.height/2 + margin};
     }
-    
-    // Check the node itself last
-    if (node->contains(x, y)) return node;
-    
-    return nullptr;
+}
+
+void MindMap::ensureSpatialIndex() {
+    if (spatialIndexStale || indexedRoot != root.get()) {
+        if (indexedRoot != root.get()) {
+            // Another tree: none of the boxes or damage recorded so far applies to it
+            subtreeBoundsStale = true;
+            boundsDamageAll = true;
+        }
+        spatialIndex.clear();
+        indexedNodes.clear();
+        indexedSlots.clear();
+        freeSlots.clear();
+        indexedRoot = root.get();
+        spatialIndexStale = false;
+
+        std::vector<std::shared_ptr<Node>> stack;
+        if (root) stack.push_back(root);
+        while (!stack.empty()) {
+            auto node = std::move(stack.back());
+            stack.pop_back();
+
+            int slot = (int)indexedNodes.size();
+            indexedNodes.push_back(node);
+            indexedSlots[node->id] = slot;
+            spatialIndex.insert(slot, hitBounds(*node));
+
+            for (auto it = node->children.rbegin(); it != node->children.rend(); ++it) {
+                stack.push_back(*it);
+            }
+        }
+    }
+    // The subtree boxes still need the marks of structure changes made meanwhile
+    syncStructure();
+}
+
+int MindMap::indexedSlot(const Node& node) const {
+    auto it = indexedSlots.find(node.id);
+    if (it == indexedSlots.end() || indexedNodes[it->second].lock().get() != &node) return -1;
+    return it->second;
+}
+
+void MindMap::indexNode(Node& node) {
+    int slot = indexedSlot(node);
+    if (slot >= 0) {
+        spatialIndex.update(slot, hitBounds(node));
+        return;
+    }
+    if (!freeSlots.empty()) {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+        indexedNodes[slot] = node.weak_from_this();
+    } else {
+        slot = (int)indexedNodes.size();
+        indexedNodes.push_back(node.weak_from_this());
+    }
+    indexedSlots[node.id] = slot;
+    spatialIndex.insert(slot, hitBounds(node));
+}
+
+void MindMap::dropSlot(int slot) {
+    spatialIndex.remove(slot);
+    if (auto node = indexedNodes[slot].lock()) {
+        auto it = indexedSlots.find(node->id);
+        if (it != indexedSlots.end() && it->second == slot) indexedSlots.erase(it);
+    }
+    indexedNodes[slot].reset();
+    freeSlots.push_back(slot);
+}
+
+bool MindMap::treePath(const Node& node, std::vector<int>& path) const {
+    path.clear();
+    const Node* current = &node;
+    std::shared_ptr<Node> parent;
+    while ((parent = current->parent.lock())) {
+        size_t index = current->childIndex;
+        if (index >= parent->children.size() || parent->children[index].get() != current) {
+            return false; // Removed from its parent
+        }
+        path.push_back((int)index);
+        current = parent.get();
+    }
+    if (current != root.get()) return false;
+    std::reverse(path.begin(), path.end());
+    return true;
+}
+
+std::vector<std::pair<std::vector<int>, std::shared_ptr<Node>>> MindMap::treeNodes(const std::vector<int>& slots) {
+    std::vector<std::pair<std::vector<int>, std::shared_ptr<Node>>> nodes;
+    nodes.reserve(slots.size());
+    std::vector<int> path;
+    for (int slot : slots) {
+        auto node = indexedNodes[slot].lock();
+        if (!node || !treePath(*node, path)) {
+            // Removed from the tree since it was indexed
+            dropSlot(slot);
+            continue;
+        }
+        nodes.push_back({path, std::move(node)});
+    }
+    std::sort(nodes.begin(), nodes.end(),
+              [](const auto& a, const auto& b) { return a.first < b.first; });
+    return nodes;
 }
 
 std::shared_ptr<Node> MindMap::hitTest(double x, double y) {
-    return hitTestRecursive(root, x, y);
+    ensureSpatialIndex();
+
+    std::vector<int> hits;
+    spatialIndex.queryPoint(x, y, hits);
+
+    // Children come after their parent in pre-order and later siblings are drawn on
+    // top of earlier ones, so the last node in pre-order is the one drawn last
+    auto nodes = treeNodes(hits);
+    for (auto it = nodes.rbegin(); it != nodes.rend(); ++it) {
+        if (it->second->contains(x, y)) return it->second;
+    }
+    return nullptr;
+}
+
+size_t MindMap::nodeCount() {
+    ensureSpatialIndex();
+    return indexedNodes.size() - freeSlots.size();
+}
+
+std::vector<std::shared_ptr<Node>> MindMap::nodesInRect(double minX, double minY, double maxX, double maxY) {
+    ensureSpatialIndex();
+
+    std::vector<int> hits;
+    spatialIndex.queryRect({minX, minY, maxX, maxY}, hits);
+
+    // The index holds the hit-test rectangles; select on the node itself
+    SpatialIndex::Rect area{minX, minY, maxX, maxY};
+    std::vector<std::shared_ptr<Node>> nodes;
+    for (auto& [path, node] : treeNodes(hits)) {
+        SpatialIndex::Rect bounds{node->x - node->width/2, node->y - node->height/2,
+                                  node->x + node->width/2, node->y + node->height/2};
+        if (area.intersects(bounds)) nodes.push_back(std::move(node));
+    }
+    return nodes;
+}
+
+void MindMap::updateNodeBounds(Node& node) {
+    // Children's incoming connections start at this node; every ancestor box contains it.
+    // A dirty node always has dirty ancestors, so the walk up stops at the first one.
+    for (auto& child : node.children) child->boundsDirty = true;
+    node.boundsDirty = true;
+    for (auto parent = node.parent.lock(); parent && !parent->boundsDirty; parent = parent->parent.lock()) {
+        parent->boundsDirty = true;
+    }
+
+    if (spatialIndexStale) return; // Rebuilt from scratch on the next query anyway
+    indexNode(node); // Inserts nodes added since the last query right away
+}
+
+void MindMap::invalidateBounds() {
+    spatialIndexStale = true;
+    subtreeBoundsStale = true;
+    boundsDamageAll = true;
+}
+
+namespace {
+    // Past this many damaged rectangles between two frames, everything is redrawn
+    constexpr size_t MAX_BOUNDS_DAMAGE = 4096;
+    // Past this many changed nodes between two calls, any node may have changed
+    constexpr size_t MAX_CHANGED_NODES = 16384;
+
+    void expand(SpatialIndex::Rect& box, const SpatialIndex::Rect& other) {
+        box.minX = std::min(box.minX, other.minX);
+        box.minY = std::min(box.minY, other.minY);
+        box.maxX = std::max(box.maxX, other.maxX);
+        box.maxY = std::max(box.maxY, other.maxY);
+    }
+}
+
+SpatialIndex::Rect connectionBounds(const Node& parent, const Node& child, int parentDepth,
+                                    const DrawExtents& extents) {
+    double pad = extents.connectionPadding;
+    if (extents.curvedConnections) {
+        // drawOrganicArrow bends the line towards a control point up to this far
+        // from the straight one
+        double dist = std::hypot(child.x - parent.x, child.y - parent.y);
+        pad += dist / 4.0 * 1.15 * std::abs(1.0 - parentDepth * 0.1);
+    }
+    if (child.connLabelWidth > 0 || child.connLabelHeight > 0) {
+        // Centred on the curve and rotated along it
+        pad += std::hypot(child.connLabelWidth / 2 + 2, child.connLabelHeight + 4);
+    }
+    return {std::min(parent.x, child.x) - pad, std::min(parent.y, child.y) - pad,
+            std::max(parent.x, child.x) + pad, std::max(parent.y, child.y) + pad};
+}
+
+bool MindMap::takeBoundsDamage(std::vector<SpatialIndex::Rect>& out) {
+    bool all = boundsDamageAll;
+    if (!all) out.insert(out.end(), boundsDamage.begin(), boundsDamage.end());
+    boundsDamage.clear();
+    boundsDamageAll = false;
+    return all;
+}
+
+void MindMap::addBoundsDamage(const SpatialIndex::Rect& rect) {
+    // A box that was never computed covers nothing drawn
+    if (boundsDamageAll || rect.maxX <= rect.minX) return;
+    boundsDamage.push_back(rect);
+    if (boundsDamage.size() > MAX_BOUNDS_DAMAGE) {
+        boundsDamage.clear();
+        boundsDamageAll = true;
+    }
+}
+
+void MindMap::syncStructure() {
+    if (!root || !root->subtreeChanged) return;
+    const bool indexed = !spatialIndexStale && indexedRoot == root.get();
+
+    // Only the marked paths; removed nodes leave the index when a query meets them
+    std::vector<Node*> stack{root.get()};
+    while (!stack.empty()) {
+        Node* node = stack.back();
+        stack.pop_back();
+        node->subtreeChanged = false;
+
+        if (node->childrenChanged) {
+            node->childrenChanged = false;
+            // The old box still covers whatever was removed below the node
+            addBoundsDamage(node->subtreeBounds);
+            updateNodeBounds(*node);
+
+            for (auto& child : node->children) {
+                if (!child->newlyAttached) continue;
+                // New or put back (e.g. by undo): index the whole subtree, which may have
+                // lost entries while it was out of the tree, and draw it anew
+                std::vector<Node*> subtree{child.get()};
+                while (!subtree.empty()) {
+                    Node* n = subtree.back();
+                    subtree.pop_back();
+                    n->childrenChanged = n->subtreeChanged = n->newlyAttached = false;
+                    n->boundsDirty = true;
+                    n->drawnBounds = SpatialIndex::Rect();
+                    if (indexed) indexNode(*n);
+                    for (auto& c : n->children) subtree.push_back(c.get());
+                }
+            }
+        }
+        for (auto& child : node->children) {
+            if (child->subtreeChanged) stack.push_back(child.get());
+        }
+    }
+}
+
+bool MindMap::takeChangedNodes(std::vector<std::weak_ptr<Node>>& out) {
+    bool all = changedNodesAll;
+    if (!all) out.insert(out.end(), changedNodes.begin(), changedNodes.end());
+    changedNodes.clear();
+    changedNodesAll = false;
+    return all;
+}
+
+const SpatialIndex::Rect& MindMap::refreshSubtreeBounds(const DrawExtents& extents) {
+    static const SpatialIndex::Rect empty;
+    if (!root) return empty;
+
+    syncStructure();
+    if (subtreeBoundsStale || extents != boundsExtents) {
+        std::vector<Node*> stack{root.get()};
+        while (!stack.empty()) {
+            Node* node = stack.back();
+            stack.pop_back();
+            node->boundsDirty = true;
+            for (auto& child : node->children) stack.push_back(child.get());
+        }
+        subtreeBoundsStale = false;
+        boundsExtents = extents;
+        boundsDamage.clear();
+        boundsDamageAll = true;
+        changedNodes.clear();
+        changedNodesAll = true;
+    }
+
+    // Post-order over the dirty nodes only; clean subtrees keep their boxes
+    struct Item {
+        Node* node;
+        int depth;
+        bool childrenDone;
+    };
+    std::vector<Item> stack;
+    if (root->boundsDirty) stack.push_back({root.get(), 0, false});
+    while (!stack.empty()) {
+        Item item = stack.back();
+        Node& node = *item.node;
+
+        if (!item.childrenDone) {
+            stack.back().childrenDone = true;
+            for (auto& child : node.children) {
+                if (child->boundsDirty) stack.push_back({child.get(), item.depth + 1, false});
+            }
+            continue;
+        }
+        stack.pop_back();
+
+        double margin = extents.nodeMargin;
+        SpatialIndex::Rect drawn{node.x - node.width/2 - margin, node.y - node.height/2 - margin,
+                                 node.x + node.width/2 + margin, node.y + node.height/2 + margin};
+        if (auto parent = node.parent.lock()) {
+            expand(drawn, connectionBounds(*parent, node, item.depth - 1, extents));
+        }
+
+        // Ancestors are only dirty because something below them moved
+        const auto& old = node.drawnBounds;
+        if (old.minX != drawn.minX || old.minY != drawn.minY ||
+            old.maxX != drawn.maxX || old.maxY != drawn.maxY) {
+            addBoundsDamage(old);
+            addBoundsDamage(drawn);
+        }
+        node.drawnBounds = drawn;
+        if (!changedNodesAll) {
+            changedNodes.push_back(node.weak_from_this());
+            if (changedNodes.size() > MAX_CHANGED_NODES) {
+                changedNodes.clear();
+                changedNodesAll = true;
+            }
+        }
+
+        SpatialIndex::Rect box = drawn;
+        for (auto& child : node.children) expand(box, child->subtreeBounds);
+
+        node.subtreeBounds = box;
+        node.boundsDirty = false;
+    }
+    return root->subtreeBounds;
 }
 
 void MindMap::saveToFile(const std::string& filename) {
@@ -227,6 +581,10 @@ void MindMap::saveToFile(const std::string& filename) {
     
     // Save Theme
     theme.save(mapElement, &doc);
+
+    if (!layoutEngine.empty()) {
+        mapElement->SetAttribute("layout", layoutEngine.c_str());
+    }
     
     // Save Nodes
     auto rootElement = root->toXMLElement(&doc);
@@ -253,6 +611,10 @@ std::shared_ptr<MindMap> MindMap::loadFromFile(const std::string& filename) {
         // New format
         // Load Theme
         map->theme.load(rootElement);
+
+        if (const char* layout = rootElement->Attribute("layout")) {
+            map->layoutEngine = layout;
+        }
         
         // Load Node Tree
         tinyxml2::XMLElement* nodeElement = rootElement->FirstChildElement("node");
@@ -272,33 +634,45 @@ std::shared_ptr<MindMap> MindMap::loadFromFile(const std::string& filename) {
 
 std::shared_ptr<Node> cloneNodeTree(std::shared_ptr<Node> original) {
     if (!original) return nullptr;
-    auto copy = std::make_shared<Node>(original->text, original->color);
-    // Copy all properties
-    copy->id = original->id; // IMPORTANT: Keep same ID for mapping back!
-    copy->fontDesc = original->fontDesc;
-    copy->textColor = original->textColor;
-    copy->imagePath = original->imagePath;
-    copy->imgWidth = original->imgWidth;
-    copy->imgHeight = original->imgHeight;
-    copy->connText = original->connText;
-    copy->connImagePath = original->connImagePath;
-    copy->connFontDesc = original->connFontDesc;
-    copy->x = original->x;
-    copy->y = original->y;
-    copy->width = original->width;
-    copy->height = original->height;
-    copy->angle = original->angle;
-    copy->manualPosition = original->manualPosition;
-    
-    // Copy overrides
-    copy->overrideColor = original->overrideColor;
-    copy->overrideTextColor = original->overrideTextColor;
-    copy->overrideFont = original->overrideFont;
-    copy->overrideConnFont = original->overrideConnFont;
-    
+    auto copy = copyNode(*original);
     for (const auto& child : original->children) {
         auto childCopy = cloneNodeTree(child);
         copy->addChild(childCopy);
     }
     return copy;
 }
+
+std::shared_ptr<Node> copyNode(const Node& original) {
+    auto copy = std::make_shared<Node>(original.text, original.color);
+    // Copy all properties
+    copy->id = original.id; // IMPORTANT: Keep same ID for mapping back!
+    copy->fontDesc = original.fontDesc;
+    copy->textColor = original.textColor;
+    copy->imagePath = original.imagePath;
+    copy->imgWidth = original.imgWidth;
+    copy->imgHeight = original.imgHeight;
+    copy->connText = original.connText;
+    copy->connImagePath = original.connImagePath;
+    copy->connFontDesc = original.connFontDesc;
+    copy->x = original.x;
+    copy->y = original.y;
+    copy->width = original.width;
+    copy->height = original.height;
+    copy->angle = original.angle;
+    copy->sectorStart = original.sectorStart;
+    copy->sectorEnd = original.sectorEnd;
+    copy->manualPosition = original.manualPosition;
+    copy->childIndex = original.childIndex; // For copies filled without insertChild
+    copy->connLabelWidth = original.connLabelWidth;
+    copy->connLabelHeight = original.connLabelHeight;
+    copy->subtreeBounds = original.subtreeBounds; // Lets a drawing of the copy cull branches
+    copy->drawnBounds = original.drawnBounds;
+    copy->boundsDirty = original.boundsDirty;
+    
+    // Copy overrides
+    copy->overrideColor = original.overrideColor;
+    copy->overrideTextColor = original.overrideTextColor;
+    copy->overrideFont = original.overrideFont;
+    copy->overrideConnFont = original.overrideConnFont;
+    return copy;
+}
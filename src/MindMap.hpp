@@ -4,7 +4,9 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <unordered_map>
 #include "Theme.hpp"
+#include "SpatialIndex.hpp"
 
 // Forward declaration to avoid including tinyxml2.h in header
 namespace tinyxml2 {
@@ -41,10 +43,42 @@ public:
     
     std::vector<std::shared_ptr<Node>> children;
     std::weak_ptr<Node> parent;
+    size_t childIndex = 0; // Position in parent->children, kept by insertChild/removeChild
     
     double x = 0.0, y = 0.0;
     double width = 0.0, height = 0.0;
     double angle = 0.0;
+
+    // Size of the label (text and icon) drawn on the incoming connection, measured
+    // together with width/height
+    double connLabelWidth = 0.0, connLabelHeight = 0.0;
+
+    // Box around everything drawn for this subtree: the node, its incoming connection
+    // with arrowhead and label, and all descendants. Refreshed by
+    // MindMap::refreshSubtreeBounds; while boundsDirty is set the box is stale, and so
+    // are the boxes of all ancestors.
+    SpatialIndex::Rect subtreeBounds;
+    SpatialIndex::Rect drawnBounds; // The node and its incoming connection only
+    bool boundsDirty = true;
+
+    // Set by markSizeDirty while width/height (and the connection label size) no
+    // longer match the node's text, fonts or images; subtreeSizeDirty is set on the node
+    // and all its ancestors, so measuring only walks the marked paths. A node moved to
+    // another depth is found through measuredDepth, its whole subtree is measured again.
+    bool sizeDirty = true;
+    bool subtreeSizeDirty = true;
+    int measuredDepth = -1; // Depth the size was measured at, -1 = never
+
+    // Set by insertChild/removeChild until MindMap has caught up with the change (its
+    // spatial index and subtree boxes): childrenChanged on the parent, subtreeChanged
+    // on the parent and all its ancestors, newlyAttached on the child that came in.
+    bool childrenChanged = false;
+    bool subtreeChanged = false;
+    bool newlyAttached = false;
+
+    // Angular sector [sectorStart, sectorEnd] the radial layout last assigned to this
+    // node, so a single subtree can be laid out again without touching the rest
+    double sectorStart = 0.0, sectorEnd = 0.0;
     
     bool manualPosition = false;
 
@@ -53,6 +87,7 @@ public:
 
     // UI Cache (type-erased to avoid strict dependencies in Model)
     mutable std::shared_ptr<void> _layoutCache;
+    mutable int _styleHandle = -1; // Last StyleTable entry, checked on use
     
     static int generateId();
 
@@ -60,8 +95,14 @@ public:
 
     void addChild(std::shared_ptr<Node> child);
 
+    // Like addChild, at the given position among the children (the end if past it)
+    void insertChild(size_t position, std::shared_ptr<Node> child);
+
     void removeChild(std::shared_ptr<Node> child);
 
+    // To be called after editing anything the node's size depends on
+    void markSizeDirty();
+
     bool isRoot() const;
 
     bool contains(double px, double py) const;
@@ -71,28 +112,120 @@ public:
     tinyxml2::XMLElement* toXMLElement(tinyxml2::XMLDocument* doc) const;
 
     static std::shared_ptr<Node> fromXMLElement(tinyxml2::XMLElement* element);
+
+private:
+    void markChildrenChanged();
+    void renumberChildren(size_t from); // Sets childIndex of children[from] onwards
+};
+
+// What the drawer paints around node boxes and connections, so that cached bounds
+// cover every pixel drawn (see MindMapDrawer::drawExtents)
+struct DrawExtents {
+    double nodeMargin = 0.0;         // Shadow and border around the node box
+    double connectionPadding = 0.0;  // Half the line width, or the arrowhead size
+    bool curvedConnections = false;  // Organic branches bulge out of the straight line
+
+    bool operator==(const DrawExtents& other) const {
+        return nodeMargin == other.nodeMargin && connectionPadding == other.connectionPadding &&
+               curvedConnections == other.curvedConnections;
+    }
+    bool operator!=(const DrawExtents& other) const { return !(*this == other); }
 };
 
 class MindMap {
 public:
     std::shared_ptr<Node> root;
     Theme theme;
+    std::string layoutEngine; // Layout engine id pinned to this map, empty = chosen automatically
 
     MindMap(const std::string& rootText);
     
     MindMap();
 
+    // Topmost node (last in pre-order, i.e. drawn last) whose rectangle, grown by
+    // NODE_MARGIN, contains the point
     std::shared_ptr<Node> hitTest(double x, double y);
+
+    // Nodes whose rectangle intersects the given area, in pre-order
+    std::vector<std::shared_ptr<Node>> nodesInRect(double minX, double minY, double maxX, double maxY);
+
+    // Refreshes the indexed rectangle of a node that moved or was resized and marks the
+    // subtree bounds that depend on it. Nodes added or removed through Node::addChild,
+    // insertChild or removeChild are caught up with on the next query by themselves.
+    void updateNodeBounds(Node& node);
+
+    // Number of nodes in the spatial index, i.e. in the tree once added subtrees are
+    // caught up with; a removed node still counts until a query meets it or the index
+    // is rebuilt
+    size_t nodeCount();
+
+    // Drops the spatial index and every subtree box, for a map that was loaded or
+    // replaced; both are rebuilt on the next query
+    void invalidateBounds();
+
+    // Brings the stale subtree boxes up to date (only the marked paths unless the
+    // extents changed) and returns the root's, i.e. the extent of the whole drawing
+    const SpatialIndex::Rect& refreshSubtreeBounds(const DrawExtents& extents);
+
+    // World rectangles whose drawing changed (old and new place of every node that
+    // refreshSubtreeBounds found moved) since the last call. Returns true instead when
+    // everything may have changed.
+    bool takeBoundsDamage(std::vector<SpatialIndex::Rect>& out);
+
+    // Nodes refreshSubtreeBounds found stale (moved, resized, edited, or with children
+    // added or removed) or that are ancestors of such nodes, since the last call.
+    // Returns true instead when any node may have changed.
+    bool takeChangedNodes(std::vector<std::weak_ptr<Node>>& out);
     
     void saveToFile(const std::string& filename);
     
     static std::shared_ptr<MindMap> loadFromFile(const std::string& filename);
 
 private:
-    std::shared_ptr<Node> hitTestRecursive(std::shared_ptr<Node> node, double x, double y);
+    // Spatial index over node rectangles, keyed by slot. Built on the first query after
+    // invalidateBounds(), then kept up to date node by node: added subtrees are indexed
+    // by syncStructure, removed nodes are dropped when a query finds them out of the
+    // tree. Hits are put in pre-order through their child positions (treePath).
+    SpatialIndex spatialIndex;
+    std::vector<std::weak_ptr<Node>> indexedNodes; // Slot -> node
+    std::unordered_map<int, int> indexedSlots;     // Node id -> slot
+    std::vector<int> freeSlots;                    // Slots of dropped nodes, for reuse
+    const Node* indexedRoot = nullptr;
+    bool spatialIndexStale = true;
+
+    bool subtreeBoundsStale = true; // Every box is stale, not just the marked ones
+    DrawExtents boundsExtents;      // Extents the current boxes were computed with
+    std::vector<SpatialIndex::Rect> boundsDamage;
+    bool boundsDamageAll = true;
+    std::vector<std::weak_ptr<Node>> changedNodes;
+    bool changedNodesAll = true;
+
+    void ensureSpatialIndex();
+    int indexedSlot(const Node& node) const; // -1 when not indexed
+    void indexNode(Node& node);              // Inserts or updates the node's entry
+    void dropSlot(int slot);
+    // Child positions (Node::childIndex) from the root down to the node, which compare
+    // like the pre-order; false when the node is no longer part of the tree
+    bool treePath(const Node& node, std::vector<int>& path) const;
+    // The nodes of the given slots still in the tree, in pre-order; drops the others
+    std::vector<std::pair<std::vector<int>, std::shared_ptr<Node>>> treeNodes(const std::vector<int>& slots);
+
+    // Catches up with the children added and removed along the marked paths (see
+    // Node::childrenChanged): indexes new subtrees and marks the boxes and damage
+    void syncStructure();
+    void addBoundsDamage(const SpatialIndex::Rect& rect);
 };
 
-// Helper to clone tree preserving IDs for layout calculation
+// Everything drawn for the connection from parent to child (curve, arrowhead and
+// label), see MindMapDrawer::drawConnection
+SpatialIndex::Rect connectionBounds(const Node& parent, const Node& child, int parentDepth,
+                                    const DrawExtents& extents);
+
+// Helper to clone tree preserving IDs for layout calculation (and background rendering).
+// The UI cache is not copied.
 std::shared_ptr<Node> cloneNodeTree(std::shared_ptr<Node> original);
 
+// Same for a single node: no children and no parent
+std::shared_ptr<Node> copyNode(const Node& original);
+
 #endif // MINDMAP_HPP
\ No newline at end of file
@@ -0,0 +1,106 @@
+#ifndef SELECTION_HPP
+#define SELECTION_HPP
+
+#include <memory>
+#include <vector>
+#include <unordered_map>
+#include "MindMap.hpp"
+
+// Selected nodes, in the order they were selected, plus the primary one.
+// Membership is a hash lookup on Node::id, so drawing a node or toggling it does not
+// depend on how many nodes are selected. Removing a node leaves a hole in the ordered
+// list that is closed the next time the list is read.
+class Selection {
+private:
+    mutable std::vector<std::shared_ptr<Node>> ordered; // May contain holes (nullptr)
+    mutable std::unordered_map<int, size_t> positions;  // Node id -> index in ordered
+    mutable size_t holes = 0;
+    std::shared_ptr<Node> primary;
+
+    void compact() const {
+        if (holes == 0) return;
+        size_t kept = 0;
+        for (auto& node : ordered) {
+            if (!node) continue;
+            positions[node->id] = kept;
+            ordered[kept++] = std::move(node);
+        }
+        ordered.resize(kept);
+        holes = 0;
+    }
+
+public:
+    bool contains(const Node& node) const {
+        return positions.count(node.id) != 0;
+    }
+
+    bool contains(const std::shared_ptr<Node>& node) const {
+        return node && contains(*node);
+    }
+
+    size_t size() const { return positions.size(); }
+
+    bool empty() const { return positions.empty(); }
+
+    void reserve(size_t count) {
+        ordered.reserve(count);
+        positions.reserve(count);
+    }
+
+    // The node actions apply to first; the first node selected unless set explicitly
+    const std::shared_ptr<Node>& primaryNode() const { return primary; }
+
+    // Selected nodes in selection order
+    const std::vector<std::shared_ptr<Node>>& nodes() const {
+        compact();
+        return ordered;
+    }
+
+    // Returns false if the node was already selected
+    bool add(const std::shared_ptr<Node>& node) {
+        if (!node || !positions.emplace(node->id, ordered.size()).second) return false;
+        ordered.push_back(node);
+        if (!primary) primary = node;
+        return true;
+    }
+
+    // Returns false if the node was not selected
+    bool remove(const std::shared_ptr<Node>& node) {
+        if (!node) return false;
+        auto it = positions.find(node->id);
+        if (it == positions.end()) return false;
+
+        ordered[it->second] = nullptr;
+        positions.erase(it);
+        holes++;
+        if (holes * 2 > ordered.size()) compact(); // Keeps nodes() and the scan below cheap
+
+        // The earliest remaining node takes over as primary
+        if (primary == node) {
+            primary = nullptr;
+            for (const auto& candidate : ordered) {
+                if (candidate) {
+                    primary = candidate;
+                    break;
+                }
+            }
+        }
+        return true;
+    }
+
+    // Makes a node primary without touching the rest of the selection
+    void setPrimary(const std::shared_ptr<Node>& node) {
+        if (!node) return;
+        add(node);
+        primary = node;
+    }
+
+    void clear() {
+        ordered.clear();
+        positions.clear();
+        holes = 0;
+        primary = nullptr;
+    }
+};
+
+#endif // SELECTION_HPP
@@ -0,0 +1,176 @@
+#include "SpatialIndex.hpp"
+#include <algorithm>
+
+namespace {
+    // Cells are never split below this half-size, so degenerate (zero-sized or
+    // coincident) rectangles cannot drive the tree arbitrarily deep
+    constexpr double MIN_CELL_HALF = 8.0;
+
+    // Half-size of the first root cell; it doubles whenever an item falls outside
+    constexpr double INITIAL_ROOT_HALF = 512.0;
+
+    double halfExtent(const SpatialIndex::Rect& rect) {
+        return std::max(rect.maxX - rect.minX, rect.maxY - rect.minY) / 2;
+    }
+
+    // Quadrant of (x, y) relative to a cell centre: bit 0 = right, bit 1 = below
+    int quadrant(double cx, double cy, double x, double y) {
+        return (x >= cx ? 1 : 0) | (y >= cy ? 2 : 0);
+    }
+}
+
+void SpatialIndex::clear() {
+    cells.clear();
+    entries.clear();
+    rootCell = -1;
+    count = 0;
+}
+
+int SpatialIndex::newCell(double cx, double cy, double half) {
+    Cell cell;
+    cell.cx = cx;
+    cell.cy = cy;
+    cell.half = half;
+    cells.push_back(std::move(cell));
+    return (int)cells.size() - 1;
+}
+
+bool SpatialIndex::fitsCell(const Cell& cell, const Rect& rect) const {
+    double x = (rect.minX + rect.maxX) / 2;
+    double y = (rect.minY + rect.maxY) / 2;
+    return x >= cell.cx - cell.half && x <= cell.cx + cell.half &&
+           y >= cell.cy - cell.half && y <= cell.cy + cell.half &&
+           halfExtent(rect) <= cell.half;
+}
+
+void SpatialIndex::growToCover(const Rect& rect) {
+    double x = (rect.minX + rect.maxX) / 2;
+    double y = (rect.minY + rect.maxY) / 2;
+
+    if (rootCell < 0) {
+        rootCell = newCell(x, y, std::max(INITIAL_ROOT_HALF, halfExtent(rect)));
+        return;
+    }
+
+    // Double the root towards the item until it fits; the old root becomes one of
+    // the new root's quadrants, so nothing already indexed has to move
+    while (!fitsCell(cells[rootCell], rect)) {
+        const Cell& old = cells[rootCell];
+        double half = old.half;
+        double cx = old.cx + (x >= old.cx ? half : -half);
+        double cy = old.cy + (y >= old.cy ? half : -half);
+        int oldRoot = rootCell;
+        rootCell = newCell(cx, cy, half * 2);
+        cells[rootCell].children[quadrant(cx, cy, cells[oldRoot].cx, cells[oldRoot].cy)] = oldRoot;
+    }
+}
+
+int SpatialIndex::findCell(const Rect& rect) {
+    growToCover(rect);
+
+    double x = (rect.minX + rect.maxX) / 2;
+    double y = (rect.minY + rect.maxY) / 2;
+    double extent = halfExtent(rect);
+
+    int cell = rootCell;
+    for (;;) {
+        double childHalf = cells[cell].half / 2;
+        if (childHalf < MIN_CELL_HALF || childHalf < extent) return cell;
+
+        int q = quadrant(cells[cell].cx, cells[cell].cy, x, y);
+        int child = cells[cell].children[q];
+        if (child < 0) {
+            double cx = cells[cell].cx + ((q & 1) ? childHalf : -childHalf);
+            double cy = cells[cell].cy + ((q & 2) ? childHalf : -childHalf);
+            child = newCell(cx, cy, childHalf); // May reallocate cells: index again below
+            cells[cell].children[q] = child;
+        }
+        cell = child;
+    }
+}
+
+void SpatialIndex::attach(int item, int cell) {
+    Entry& entry = entries[item];
+    entry.cell = cell;
+    entry.slot = (int)cells[cell].items.size();
+    cells[cell].items.push_back(item);
+}
+
+void SpatialIndex::detach(int item) {
+    Entry& entry = entries[item];
+    auto& items = cells[entry.cell].items;
+    int last = items.back();
+    items[entry.slot] = last;
+    entries[last].slot = entry.slot;
+    items.pop_back();
+    entry.cell = -1;
+}
+
+bool SpatialIndex::containsItem(int item) const {
+    return item >= 0 && item < (int)entries.size() && entries[item].cell >= 0;
+}
+
+void SpatialIndex::insert(int item, const Rect& rect) {
+    if (item < 0) return;
+    if (containsItem(item)) {
+        update(item, rect);
+        return;
+    }
+    if (item >= (int)entries.size()) entries.resize(item + 1);
+
+    entries[item].rect = rect;
+    attach(item, findCell(rect));
+    count++;
+}
+
+void SpatialIndex::update(int item, const Rect& rect) {
+    if (!containsItem(item)) {
+        insert(item, rect);
+        return;
+    }
+
+    entries[item].rect = rect;
+    // Small moves usually stay within the loose bounds of the current cell
+    if (fitsCell(cells[entries[item].cell], rect)) return;
+
+    detach(item);
+    attach(item, findCell(rect));
+}
+
+void SpatialIndex::remove(int item) {
+    if (!containsItem(item)) return;
+    detach(item);
+    count--;
+}
+
+template <typename Predicate>
+void SpatialIndex::query(Predicate hit, std::vector<int>& out) const {
+    if (rootCell < 0) return;
+
+    std::vector<int> stack{rootCell};
+    while (!stack.empty()) {
+        const Cell& cell = cells[stack.back()];
+        stack.pop_back();
+
+        Rect loose{cell.cx - 2 * cell.half, cell.cy - 2 * cell.half,
+                   cell.cx + 2 * cell.half, cell.cy + 2 * cell.half};
+        if (!hit(loose)) continue;
+
+        for (int item : cell.items) {
+            if (hit(entries[item].rect)) out.push_back(item);
+        }
+        for (int child : cell.children) {
+            if (child >= 0) stack.push_back(child);
+        }
+    }
+}
+
+void SpatialIndex::queryPoint(double x, double y, std::vector<int>& out) const {
+    auto hit = [x, y](const Rect& rect) { return rect.contains(x, y); };
+    query(hit, out);
+}
+
+void SpatialIndex::queryRect(const Rect& rect, std::vector<int>& out) const {
+    auto hit = [&rect](const Rect& other) { return rect.intersects(other); };
+    query(hit, out);
+}
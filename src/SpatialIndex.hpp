@@ -0,0 +1,81 @@
+#ifndef SPATIAL_INDEX_HPP
+#define SPATIAL_INDEX_HPP
+
+#include <vector>
+#include <cstddef>
+
+// Loose quadtree over axis-aligned rectangles.
+// Items are small dense integers chosen by the caller (MindMap hands out slots and
+// reuses those of removed nodes), so the per-item bookkeeping is a plain vector rather
+// than a map.
+// Every item lives in exactly one cell: the deepest one whose half-size still covers
+// the item's half-extent and whose centre region holds the item's centre. A cell's
+// loose bounds are twice its tight bounds, so an item never sticks out of its cell and
+// moving an item only touches the cell it leaves and the one it enters.
+class SpatialIndex {
+public:
+    struct Rect {
+        double minX = 0.0, minY = 0.0, maxX = 0.0, maxY = 0.0;
+
+        bool contains(double x, double y) const {
+            return x >= minX && x <= maxX && y >= minY && y <= maxY;
+        }
+
+        bool intersects(const Rect& other) const {
+            return minX <= other.maxX && maxX >= other.minX &&
+                   minY <= other.maxY && maxY >= other.minY;
+        }
+    };
+
+    void clear();
+
+    void insert(int item, const Rect& rect);
+
+    // Moves an item that is already indexed (inserts it otherwise)
+    void update(int item, const Rect& rect);
+
+    void remove(int item);
+
+    bool containsItem(int item) const;
+
+    // Items whose rectangle contains the point, in no particular order.
+    // Results are appended to out.
+    void queryPoint(double x, double y, std::vector<int>& out) const;
+
+    // Items whose rectangle intersects the given one, in no particular order.
+    // Results are appended to out.
+    void queryRect(const Rect& rect, std::vector<int>& out) const;
+
+    size_t size() const { return count; }
+
+private:
+    struct Cell {
+        double cx, cy, half; // Tight bounds are [c - half, c + half]
+        int children[4] = {-1, -1, -1, -1};
+        std::vector<int> items;
+    };
+
+    struct Entry {
+        Rect rect;
+        int cell = -1; // -1 = not indexed
+        int slot = 0;  // Position inside cells[cell].items
+    };
+
+    std::vector<Cell> cells;
+    std::vector<Entry> entries; // Indexed by item
+    int rootCell = -1;
+    size_t count = 0;
+
+    int newCell(double cx, double cy, double half);
+    void growToCover(const Rect& rect);
+    int findCell(const Rect& rect);
+    bool fitsCell(const Cell& cell, const Rect& rect) const;
+    void attach(int item, int cell);
+    void detach(int item);
+
+    // Items whose rectangle passes hit; cells are pruned with the same predicate
+    template <typename Predicate>
+    void query(Predicate hit, std::vector<int>& out) const;
+};
+
+#endif // SPATIAL_INDEX_HPP
@@ -0,0 +1,157 @@
+#ifndef STYLE_TABLE_HPP
+#define STYLE_TABLE_HPP
+
+#include <deque>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <cstdint>
+#include <cairomm/cairomm.h>
+#include <pangomm/fontdescription.h>
+#include "MindMap.hpp"
+#include "Theme.hpp"
+
+// Node styles as they are drawn: the theme level a depth falls in, with the node's own
+// text colour and font overrides applied. Each distinct combination is resolved once
+// and shared by every node that has it, so drawing and measuring a node copy no
+// patterns and parse no font descriptions.
+// Node::_styleHandle remembers the entry a node had last time. It is only a hint: the
+// entry is checked against the node's current depth and overrides on every lookup,
+// so edits need no notification. The table starts over when the theme changes.
+// A table that draws nodes shared with other threads does not store handles on them.
+// Entries never move, references stay valid until the next theme change.
+class StyleTable {
+public:
+    const NodeStyle& resolve(const Node& node, int depth, const Theme& theme, bool rememberHandle = true) {
+        sync(theme);
+        int level = levelFor(depth, theme);
+        bool overrideFont = node.overrideFont && !node.fontDesc.empty();
+
+        int handle = node._styleHandle;
+        if (handle >= 0 && handle < (int)entries.size()) {
+            const Entry& entry = entries[handle];
+            const Key& key = entry.key;
+            if (key.level == level && key.overrideTextColor == node.overrideTextColor &&
+                key.overrideFont == overrideFont &&
+                (!key.overrideTextColor || (key.r == node.textColor.r && key.g == node.textColor.g && key.b == node.textColor.b)) &&
+                (!key.overrideFont || key.fontDesc == node.fontDesc)) {
+                return entry.style;
+            }
+        }
+
+        Key key;
+        key.level = level;
+        key.overrideTextColor = node.overrideTextColor;
+        if (key.overrideTextColor) {
+            key.r = node.textColor.r;
+            key.g = node.textColor.g;
+            key.b = node.textColor.b;
+        }
+        key.overrideFont = overrideFont;
+        if (overrideFont) key.fontDesc = node.fontDesc;
+
+        handle = find(key, theme);
+        if (rememberHandle) node._styleHandle = handle;
+        return entries[handle].style;
+    }
+
+    // The theme's style for a depth, without any node override
+    const NodeStyle& levelStyle(int depth, const Theme& theme) {
+        sync(theme);
+        Key key;
+        key.level = levelFor(depth, theme);
+        return entries[find(key, theme)].style;
+    }
+
+    size_t size() const { return entries.size(); }
+
+private:
+    struct Key {
+        int level = 0; // Theme level key (unused for a theme without levels)
+        bool overrideTextColor = false;
+        double r = 0.0, g = 0.0, b = 0.0;
+        bool overrideFont = false;
+        std::string fontDesc;
+
+        bool operator==(const Key& other) const {
+            return level == other.level && overrideTextColor == other.overrideTextColor &&
+                   r == other.r && g == other.g && b == other.b &&
+                   overrideFont == other.overrideFont && fontDesc == other.fontDesc;
+        }
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key& key) const {
+            size_t h = std::hash<int>()(key.level);
+            auto mix = [&h](size_t value) { h ^= value + 0x9e3779b9 + (h << 6) + (h >> 2); };
+            mix(key.overrideTextColor);
+            mix(std::hash<double>()(key.r));
+            mix(std::hash<double>()(key.g));
+            mix(std::hash<double>()(key.b));
+            mix(key.overrideFont);
+            mix(std::hash<std::string>()(key.fontDesc));
+            return h;
+        }
+    };
+
+    struct Entry {
+        Key key;
+        NodeStyle style;
+    };
+
+    uint64_t revision = 0;
+    std::deque<Entry> entries;
+    std::unordered_map<Key, int, KeyHash> index;
+    std::vector<int> levelByDepth; // Memo of levelFor
+
+    void sync(const Theme& theme) {
+        if (theme.revision() == revision) return;
+        entries.clear();
+        index.clear();
+        levelByDepth.clear();
+        revision = theme.revision();
+    }
+
+    // Key of the theme level whose style applies at a depth (see Theme::getStyle)
+    int levelFor(int depth, const Theme& theme) {
+        if (depth < 0) depth = 0;
+        if (depth < (int)levelByDepth.size()) return levelByDepth[depth];
+
+        const auto& levels = theme.getLevelStyles();
+        while ((int)levelByDepth.size() <= depth) {
+            int d = (int)levelByDepth.size();
+            int level = 0;
+            if (!levels.empty()) {
+                auto it = levels.upper_bound(d);
+                if (it != levels.begin()) --it;
+                level = it->first;
+            }
+            levelByDepth.push_back(level);
+        }
+        return levelByDepth[depth];
+    }
+
+    int find(const Key& key, const Theme& theme) {
+        auto it = index.find(key);
+        if (it != index.end()) return it->second;
+
+        Entry entry;
+        entry.key = key;
+        const auto& levels = theme.getLevelStyles();
+        entry.style = levels.empty() ? NodeStyle() : levels.at(key.level); // What getStyle() gives
+        if (key.overrideTextColor) {
+            entry.style.textColor = Cairo::SolidPattern::create_rgb(key.r, key.g, key.b);
+        }
+        if (key.overrideFont) {
+            entry.style.fontDescription = Pango::FontDescription(key.fontDesc);
+        }
+
+        int handle = (int)entries.size();
+        entries.push_back(std::move(entry));
+        index.emplace(key, handle);
+        return handle;
+    }
+};
+
+#endif // STYLE_TABLE_HPP
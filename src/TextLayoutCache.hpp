@@ -0,0 +1,186 @@
+#ifndef TEXT_LAYOUT_CACHE_HPP
+#define TEXT_LAYOUT_CACHE_HPP
+
+#include <pangomm.h>
+#include <cairomm/cairomm.h>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <functional>
+#include <cstddef>
+#include <cstdint>
+#include "Constants.hpp"
+
+// Shaped text, shared by every node, map and export that shows the same text in the
+// same font and wrap width, so a label repeated across a map is shaped once.
+// Entries are dropped least recently used first once their estimated size goes over
+// the budget. Nodes only keep weak references (see CachedLayoutData), so the budget
+// bounds the layouts kept alive however large the maps are.
+// Pango layouts belong to the thread that made them: the shared instance is for the
+// UI thread, each render worker uses a cache of its own.
+class TextLayoutCache {
+public:
+    struct Entry {
+        Glib::RefPtr<Pango::Layout> layout;
+        std::string text;
+        Pango::FontDescription font;
+        int wrapWidth = 0; // 0 = no wrapping
+        size_t bytes = 0;
+
+        // Place in the cache's LRU list, valid while cached
+        mutable std::list<std::shared_ptr<const Entry>>::iterator position;
+        mutable bool cached = false;
+
+        bool matches(const std::string& t, const Pango::FontDescription& f, int w) const {
+            return wrapWidth == w && text == t && font == f;
+        }
+    };
+
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+        size_t entries = 0;
+        size_t bytes = 0;
+        size_t maxBytes = 0;
+
+        double hitRate() const {
+            uint64_t lookups = hits + misses;
+            return lookups ? double(hits) / double(lookups) : 0.0;
+        }
+    };
+
+    explicit TextLayoutCache(size_t maxBytes = E4Maps::TEXT_LAYOUT_CACHE_MAX_BYTES) : maxBytes(maxBytes) {}
+
+    TextLayoutCache(const TextLayoutCache&) = delete;
+    TextLayoutCache& operator=(const TextLayoutCache&) = delete;
+
+    // The entry for text (markup if it parses, plain otherwise) in font, wrapped at
+    // wrapWidth pixels; shaped with cr's font settings if it is not cached yet
+    std::shared_ptr<const Entry> get(const Cairo::RefPtr<Cairo::Context>& cr, const std::string& text,
+                                     const Pango::FontDescription& font, int wrapWidth) {
+        size_t hash = keyHash(text, font, wrapWidth);
+        auto range = index.equal_range(hash);
+        for (auto it = range.first; it != range.second; ++it) {
+            if ((*it->second)->matches(text, font, wrapWidth)) {
+                counters.hits++;
+                lru.splice(lru.begin(), lru, it->second);
+                return *it->second;
+            }
+        }
+        counters.misses++;
+
+        auto entry = std::shared_ptr<Entry>(new Entry); // Not make_shared: weak references outlive it
+        entry->layout = Pango::Layout::create(cr);
+        shape(entry->layout, text, font, wrapWidth);
+        entry->text = text;
+        entry->font = font;
+        entry->wrapWidth = wrapWidth;
+        entry->bytes = estimateBytes(*entry);
+
+        lru.push_front(entry);
+        entry->position = lru.begin();
+        entry->cached = true;
+        index.emplace(hash, lru.begin());
+        usedBytes += entry->bytes;
+        evict();
+        return entry;
+    }
+
+    // Sets a layout's text (markup if it parses, plain otherwise), font and wrap width,
+    // replacing whatever it showed before
+    static void shape(const Glib::RefPtr<Pango::Layout>& layout, const std::string& text,
+                      const Pango::FontDescription& font, int wrapWidth) {
+        try {
+            layout->set_markup(text);
+        } catch (const Glib::Error& e) {
+            layout->set_attributes(Pango::AttrList()); // Left over from earlier markup
+            layout->set_text(text); // Fallback to plain text on error
+        }
+        layout->set_font_description(font);
+        if (wrapWidth > 0) {
+            layout->set_width(wrapWidth * Pango::SCALE);
+            layout->set_wrap(Pango::WRAP_WORD);
+        } else {
+            layout->set_width(-1);
+        }
+    }
+
+    // Lookup through a weak reference kept by the caller: marks the entry as just used.
+    // Returns false (a miss) when the entry is no longer cached.
+    bool touch(const Entry& entry) {
+        if (!entry.cached) return false;
+        counters.hits++;
+        lru.splice(lru.begin(), lru, entry.position);
+        return true;
+    }
+
+    void setMaxBytes(size_t bytes) {
+        maxBytes = bytes;
+        evict();
+    }
+
+    Stats stats() const {
+        Stats result = counters;
+        result.entries = lru.size();
+        result.bytes = usedBytes;
+        result.maxBytes = maxBytes;
+        return result;
+    }
+
+    void clear() {
+        for (const auto& entry : lru) entry->cached = false;
+        lru.clear();
+        index.clear();
+        usedBytes = 0;
+    }
+
+    // The UI thread's cache, shared by every map and export
+    static TextLayoutCache& getInstance() {
+        static TextLayoutCache instance;
+        return instance;
+    }
+
+private:
+    using Lru = std::list<std::shared_ptr<const Entry>>; // Most recently used first
+
+    size_t maxBytes;
+    size_t usedBytes = 0;
+    Stats counters;
+    Lru lru;
+    std::unordered_multimap<size_t, Lru::iterator> index; // Key hash -> entry
+
+    static size_t keyHash(const std::string& text, const Pango::FontDescription& font, int wrapWidth) {
+        size_t h = std::hash<std::string>()(text);
+        h ^= std::hash<unsigned>()(font.hash()) + 0x9e3779b9 + (h << 6) + (h >> 2);
+        h ^= std::hash<int>()(wrapWidth) + 0x9e3779b9 + (h << 6) + (h >> 2);
+        return h;
+    }
+
+    // Pango does not account for its memory. Estimate a fixed overhead per layout, plus
+    // glyph, cluster and attribute data per byte of text, plus one run list per line.
+    static size_t estimateBytes(const Entry& entry) {
+        return sizeof(Entry) + 512 + entry.text.size() * 48 + (size_t)entry.layout->get_line_count() * 96;
+    }
+
+    void evict() {
+        // The entry just added survives even when it alone is over the budget
+        while (usedBytes > maxBytes && lru.size() > 1) {
+            const auto& victim = lru.back();
+            auto range = index.equal_range(keyHash(victim->text, victim->font, victim->wrapWidth));
+            for (auto it = range.first; it != range.second; ++it) {
+                if (it->second == std::prev(lru.end())) {
+                    index.erase(it);
+                    break;
+                }
+            }
+            usedBytes -= victim->bytes;
+            victim->cached = false;
+            lru.pop_back();
+            counters.evictions++;
+        }
+    }
+};
+
+#endif // TEXT_LAYOUT_CACHE_HPP
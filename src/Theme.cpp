@@ -1,6 +1,7 @@
 #include "Theme.hpp"
 #include <pangomm.h> // Ensure Pango::SCALE is available
 #include <iostream>
+#include <atomic>
 
 // Helper to serialize Pattern to Hex
 static std::string patternToHex(const Cairo::RefPtr<Cairo::Pattern>& pat) {
@@ -21,6 +22,14 @@ static Cairo::RefPtr<Cairo::Pattern> hexToPattern(const std::string& hex) {
     return Cairo::SolidPattern::create_rgba(r, g, b, a);
 }
 
+// Same colour in a pattern of its own. Reads through the C object, without taking a
+// Cairo::RefPtr to the source, so it is safe while other threads read the same pattern.
+static Cairo::RefPtr<Cairo::Pattern> copyPattern(const Cairo::RefPtr<Cairo::Pattern>& pat) {
+    double r = 0.0, g = 0.0, b = 0.0, a = 1.0;
+    if (pat) cairo_pattern_get_rgba(pat->cobj(), &r, &g, &b, &a); // Black for non-solid patterns
+    return Cairo::SolidPattern::create_rgba(r, g, b, a);
+}
+
 // NodeStyle default constructor
 NodeStyle::NodeStyle()
     : borderWidth(1.0),
@@ -52,6 +61,30 @@ NodeStyle::NodeStyle()
     connectionFontDescription.set_size(12 * Pango::SCALE); // 9pt
 }
 
+NodeStyle NodeStyle::detachedCopy() const {
+    NodeStyle copy;
+    copy.backgroundColor = copyPattern(backgroundColor);
+    copy.backgroundHoverColor = copyPattern(backgroundHoverColor);
+    copy.borderColor = copyPattern(borderColor);
+    copy.borderWidth = borderWidth;
+    copy.shadowColor = copyPattern(shadowColor);
+    copy.shadowOffsetX = shadowOffsetX;
+    copy.shadowOffsetY = shadowOffsetY;
+    copy.shadowBlurRadius = shadowBlurRadius;
+    copy.fontDescription = fontDescription; // Font descriptions are copied deeply
+    copy.connectionFontDescription = connectionFontDescription;
+    copy.textColor = copyPattern(textColor);
+    copy.textHoverColor = copyPattern(textHoverColor);
+    copy.cornerRadius = cornerRadius;
+    copy.horizontalPadding = horizontalPadding;
+    copy.verticalPadding = verticalPadding;
+    copy.connectionColor = copyPattern(connectionColor);
+    copy.connectionWidth = connectionWidth;
+    copy.connectionDash = connectionDash;
+    copy.connectionType = connectionType;
+    return copy;
+}
+
 tinyxml2::XMLElement* NodeStyle::toXMLElement(tinyxml2::XMLDocument* doc, const std::string& elementName) const {
     auto el = doc->NewElement(elementName.c_str());
     
@@ -110,10 +143,34 @@ NodeStyle NodeStyle::fromXMLElement(tinyxml2::XMLElement* element) {
 }
 
 // Theme constructor
-Theme::Theme() : name("Default") {
+Theme::Theme() : name("Default"), rev(nextRevision()) {
     initializeDefaultStyles();
 }
 
+Theme::Theme(const Theme& other) : name(other.name), levelStyles(other.levelStyles), rev(nextRevision()) {}
+
+Theme& Theme::operator=(const Theme& other) {
+    name = other.name;
+    levelStyles = other.levelStyles;
+    rev = nextRevision();
+    return *this;
+}
+
+uint64_t Theme::nextRevision() {
+    static std::atomic<uint64_t> last{0}; // Themes are also copied on render workers
+    return ++last;
+}
+
+Theme Theme::detachedCopy() const {
+    Theme copy;
+    copy.name = name;
+    copy.levelStyles.clear();
+    for (const auto& pair : levelStyles) {
+        copy.levelStyles[pair.first] = pair.second.detachedCopy();
+    }
+    return copy;
+}
+
 void Theme::save(tinyxml2::XMLElement* root, tinyxml2::XMLDocument* doc) const {
     auto themeEl = doc->NewElement("theme");
     themeEl->SetAttribute("name", name.c_str());
@@ -130,6 +187,7 @@ void Theme::save(tinyxml2::XMLElement* root, tinyxml2::XMLDocument* doc) const {
 }
 
 void Theme::load(tinyxml2::XMLElement* root) {
+    rev = nextRevision();
     auto themeEl = root->FirstChildElement("theme");
     if (!themeEl) return;
     
@@ -4,6 +4,7 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <cstdint>
 #include <cairomm/cairomm.h>
 #include <pangomm/fontdescription.h>
 #include "tinyxml2.h"
@@ -45,6 +46,10 @@ struct NodeStyle {
     int connectionType; // 0 = arrow/freccia, 1 = branch/asse Tony Buzan
 
     NodeStyle(); // Default constructor
+
+    // Copy that shares no pattern with this one. Cairo::RefPtr reference counts are not
+    // atomic, so a style used on another thread must be one of these.
+    NodeStyle detachedCopy() const;
     
     // Serialization
     tinyxml2::XMLElement* toXMLElement(tinyxml2::XMLDocument* doc, const std::string& elementName) const;
@@ -60,6 +65,8 @@ struct NodeStyle {
 class Theme {
 public:
     Theme();
+    Theme(const Theme& other);
+    Theme& operator=(const Theme& other);
 
     /**
      * @brief Get the NodeStyle for a given hierarchy level.
@@ -71,9 +78,20 @@ public:
     // Theme Management
     void setName(const std::string& n) { name = n; }
     std::string getName() const { return name; }
+
+    // Copy whose styles share no pattern with this theme (see NodeStyle::detachedCopy).
+    // Safe to call while other threads read this theme.
+    Theme detachedCopy() const;
     
+    // Changes whenever the styles may have changed (copies, loads, editor access), so
+    // what is derived from them (see StyleTable) knows when to start over
+    uint64_t revision() const { return rev; }
+
     // Access for Editor
-    std::map<int, NodeStyle>& getLevelStyles() { return levelStyles; }
+    std::map<int, NodeStyle>& getLevelStyles() {
+        rev = nextRevision();
+        return levelStyles;
+    }
     const std::map<int, NodeStyle>& getLevelStyles() const { return levelStyles; } // Const overload
     
     // Serialization
@@ -83,6 +101,9 @@ public:
 private:
     std::string name;
     std::map<int, NodeStyle> levelStyles;
+    uint64_t rev;
+
+    static uint64_t nextRevision();
 
     // Helper to initialize default styles
     void initializeDefaultStyles();
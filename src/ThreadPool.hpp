@@ -0,0 +1,113 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <deque>
+#include <vector>
+#include <algorithm>
+
+// Fixed-size pool of worker threads.
+// The calling thread takes part in parallelFor, so a pool of size 1 owns no
+// worker at all and simply runs everything inline.
+class ThreadPool {
+private:
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable taskAvailable;
+    bool stopping = false;
+
+    void workerLoop() {
+        for (;;) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                taskAvailable.wait(lock, [this]() { return stopping || !tasks.empty(); });
+                if (stopping && tasks.empty()) return;
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            task();
+        }
+    }
+
+public:
+    // threadCount = 0 uses one thread per hardware core
+    explicit ThreadPool(unsigned threadCount = 0) {
+        if (threadCount == 0) threadCount = std::max(1u, std::thread::hardware_concurrency());
+        for (unsigned i = 1; i < threadCount; i++) {
+            workers.emplace_back([this]() { workerLoop(); });
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        taskAvailable.notify_all();
+        for (auto& worker : workers) worker.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Number of threads taking part in parallelFor (workers + caller)
+    size_t size() const { return workers.size() + 1; }
+
+    // Queues a task for the workers and returns immediately. Tasks still queued when
+    // the pool is destroyed are run before the workers exit; with no worker at all
+    // (a pool of size 1) the task runs inline.
+    void submit(std::function<void()> task) {
+        if (workers.empty()) {
+            task();
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.push_back(std::move(task));
+        }
+        taskAvailable.notify_one();
+    }
+
+    // Splits [0, count) into one contiguous chunk per thread (at most maxChunks, 0 = no
+    // limit) and runs fn(begin, end) on each of them. Blocks until every chunk is done.
+    // Several threads may call it at once; their chunks simply share the workers.
+    void parallelFor(size_t count, const std::function<void(size_t, size_t)>& fn, size_t maxChunks = 0) {
+        size_t chunks = std::min(size(), count);
+        if (maxChunks > 0) chunks = std::min(chunks, maxChunks);
+        if (chunks <= 1) {
+            if (count > 0) fn(0, count);
+            return;
+        }
+
+        size_t chunkSize = (count + chunks - 1) / chunks;
+        size_t pending = chunks - 1;
+        std::mutex doneMutex;
+        std::condition_variable done;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (size_t c = 1; c < chunks; c++) {
+                size_t begin = c * chunkSize;
+                size_t end = std::min(count, begin + chunkSize);
+                tasks.emplace_back([&, begin, end]() {
+                    if (begin < end) fn(begin, end);
+                    std::lock_guard<std::mutex> doneLock(doneMutex);
+                    if (--pending == 0) done.notify_one();
+                });
+            }
+        }
+        taskAvailable.notify_all();
+
+        fn(0, std::min(count, chunkSize));
+
+        std::unique_lock<std::mutex> lock(doneMutex);
+        done.wait(lock, [&]() { return pending == 0; });
+    }
+};
+
+#endif // THREAD_POOL_HPP
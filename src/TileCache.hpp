@@ -0,0 +1,211 @@
+#ifndef TILE_CACHE_HPP
+#define TILE_CACHE_HPP
+
+#include <cairomm/cairomm.h>
+#include <list>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <functional>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+// Rendered pieces of the map, so panning is a blit instead of a full redraw.
+// A tile is identified by its zoom bucket and its position in that bucket's pixel
+// space (world coordinates times the scale), and tiles are dropped least recently
+// used first once their total size goes over the budget.
+// Zoom buckets are exact scales: tiles are only ever blitted 1:1 so text stays
+// sharp, and the tiles of zoom levels left behind simply age out.
+//
+// Invalidated tiles are kept as stale until they are replaced, so there is something
+// to show while a worker renders the new content. A tile can also be requested:
+// the request's ticket is only honoured if nothing invalidated the tile meanwhile.
+class TileCache {
+public:
+    struct Key {
+        double scale;
+        int tx, ty;
+
+        bool operator==(const Key& other) const {
+            return scale == other.scale && tx == other.tx && ty == other.ty;
+        }
+    };
+
+    TileCache(int tileSize, size_t maxBytes) : size(tileSize), maxBytes(maxBytes) {}
+
+    int tileSize() const { return size; }
+
+    size_t bytes() const { return usedBytes; }
+
+    // Up-to-date tile or an empty pointer; a hit makes the tile the most recently used
+    Cairo::RefPtr<Cairo::Surface> find(const Key& key) {
+        auto it = tiles.find(key);
+        if (it == tiles.end() || it->second.stale) return Cairo::RefPtr<Cairo::Surface>();
+        touch(it->second);
+        return it->second.surface;
+    }
+
+    // Whatever was last rendered for the tile, stale or not (for placeholders)
+    Cairo::RefPtr<Cairo::Surface> findAny(const Key& key) const {
+        auto it = tiles.find(key);
+        if (it == tiles.end()) return Cairo::RefPtr<Cairo::Surface>();
+        return it->second.surface;
+    }
+
+    void insert(const Key& key, const Cairo::RefPtr<Cairo::Surface>& surface, size_t bytes) {
+        Entry& entry = entryFor(key);
+        usedBytes += bytes;
+        usedBytes -= entry.bytes;
+        entry.surface = surface;
+        entry.bytes = bytes;
+        entry.stale = false;
+        entry.ticket = 0; // A newer rendering than any request in flight
+        evict();
+    }
+
+    // Marks the tile as being rendered; returns the ticket to deliver it with
+    uint64_t request(const Key& key) {
+        Entry& entry = entryFor(key);
+        entry.ticket = ++lastTicket;
+        return entry.ticket;
+    }
+
+    bool isRequested(const Key& key) const {
+        auto it = tiles.find(key);
+        return it != tiles.end() && it->second.ticket != 0;
+    }
+
+    // Result of request(); dropped (false) when the tile was invalidated, evicted or
+    // rendered again since. An empty surface withdraws the request.
+    bool deliver(const Key& key, uint64_t ticket, const Cairo::RefPtr<Cairo::Surface>& surface, size_t bytes) {
+        auto it = tiles.find(key);
+        if (it == tiles.end() || it->second.ticket != ticket) return false;
+        if (!surface) {
+            it->second.ticket = 0;
+            if (!it->second.surface) erase(key);
+            return false;
+        }
+        insert(key, surface, bytes);
+        return true;
+    }
+
+    // Nearest other zoom bucket with tiles in it, or 0 when there is none
+    double nearestScale(double scale) const {
+        double best = 0.0;
+        for (const auto& entry : buckets) {
+            if (entry.first == scale) continue;
+            if (best == 0.0 || std::abs(std::log(entry.first / scale)) < std::abs(std::log(best / scale))) {
+                best = entry.first;
+            }
+        }
+        return best;
+    }
+
+    // Marks every tile, at any zoom, that overlaps the world rectangle as stale, and
+    // withdraws the requests for them
+    void invalidate(double minX, double minY, double maxX, double maxY) {
+        for (const auto& [scale, count] : buckets) {
+            int tx0 = (int)std::floor(minX * scale / size);
+            int ty0 = (int)std::floor(minY * scale / size);
+            int tx1 = (int)std::floor(maxX * scale / size);
+            int ty1 = (int)std::floor(maxY * scale / size);
+            double area = double(tx1 - tx0 + 1) * double(ty1 - ty0 + 1);
+
+            if (area <= double(count)) {
+                for (int ty = ty0; ty <= ty1; ty++) {
+                    for (int tx = tx0; tx <= tx1; tx++) {
+                        auto it = tiles.find(Key{scale, tx, ty});
+                        if (it != tiles.end()) markStale(it->second);
+                    }
+                }
+            } else {
+                // Damage larger than what is cached at this zoom: check the tiles instead
+                for (auto& entry : tiles) {
+                    const Key& key = entry.first;
+                    if (key.scale == scale && key.tx >= tx0 && key.tx <= tx1 && key.ty >= ty0 && key.ty <= ty1) {
+                        markStale(entry.second);
+                    }
+                }
+            }
+        }
+    }
+
+    // Marks every tile stale and withdraws every request
+    void invalidateAll() {
+        for (auto& entry : tiles) markStale(entry.second);
+    }
+
+    void clear() {
+        tiles.clear();
+        lru.clear();
+        buckets.clear();
+        usedBytes = 0;
+    }
+
+private:
+    struct KeyHash {
+        size_t operator()(const Key& key) const {
+            size_t h = std::hash<double>()(key.scale);
+            h ^= std::hash<int>()(key.tx) + 0x9e3779b9 + (h << 6) + (h >> 2);
+            h ^= std::hash<int>()(key.ty) + 0x9e3779b9 + (h << 6) + (h >> 2);
+            return h;
+        }
+    };
+
+    struct Entry {
+        Cairo::RefPtr<Cairo::Surface> surface; // Empty while only requested
+        size_t bytes = 0;
+        bool stale = false;
+        uint64_t ticket = 0; // Request in flight, 0 = none
+        std::list<Key>::iterator lru;
+    };
+
+    int size;
+    size_t maxBytes;
+    size_t usedBytes = 0;
+    uint64_t lastTicket = 0;
+    std::list<Key> lru; // Most recently used first
+    std::unordered_map<Key, Entry, KeyHash> tiles;
+    std::map<double, size_t> buckets; // Scale -> number of entries at it
+
+    void touch(Entry& entry) {
+        lru.splice(lru.begin(), lru, entry.lru);
+    }
+
+    static void markStale(Entry& entry) {
+        entry.stale = true;
+        entry.ticket = 0;
+    }
+
+    // Existing entry (made most recently used) or a new, empty one
+    Entry& entryFor(const Key& key) {
+        auto it = tiles.find(key);
+        if (it != tiles.end()) {
+            touch(it->second);
+            return it->second;
+        }
+        lru.push_front(key);
+        Entry& entry = tiles[key];
+        entry.lru = lru.begin();
+        buckets[key.scale]++;
+        return entry;
+    }
+
+    void evict() {
+        // The tile just added survives even when it alone is over the budget
+        while (usedBytes > maxBytes && lru.size() > 1) erase(lru.back());
+    }
+
+    void erase(Key key) { // By value: callers pass lru.back(), which this frees
+        auto it = tiles.find(key);
+        if (it == tiles.end()) return;
+        usedBytes -= it->second.bytes;
+        lru.erase(it->second.lru);
+        tiles.erase(it);
+        auto bucket = buckets.find(key.scale);
+        if (--bucket->second == 0) buckets.erase(bucket);
+    }
+};
+
+#endif // TILE_CACHE_HPP